@@ -7,7 +7,9 @@
 #include "bumblebee_detect.hpp"
 #include "esp_camera.h"
 #include "esp_log.h"
+#include "esp_heap_caps.h"
 #include "sd_card.hpp"
+#include "frame_convert.hpp"
 #include <esp_system.h>
 #include <string.h>
 #include <vector>
@@ -68,70 +70,39 @@ static esp_err_t init_camera(void)
     return err;
 }
 
-// Hilfsfunktion: Bild aufnehmen, croppen und in RGB888 konvertieren
+// Hilfsfunktion: Bild aufnehmen, croppen und in RGB888 konvertieren.
+// Liest direkt aus dem Kamera-Framebuffer und konvertiert nur den 224x224-Ausschnitt
+// in den vorab allokierten Puffer von cropped_img.
 static bool capture_and_convert_image(dl::image::img_t &cropped_img) {
     camera_fb_t *pic = esp_camera_fb_get();
     if (!pic) {
         ESP_LOGE("CAM", "Failed to capture image");
         return false;
     }
-    dl::image::img_t img;
-    img.height = pic->height;
-    img.width = pic->width;
-    img.pix_type = dl::image::DL_IMAGE_PIX_TYPE_RGB565;
-    img.data = malloc(pic->len);
-    if (!img.data) {
-        ESP_LOGE("MEM", "Memory allocation failed");
+    if (pic->width < MODEL_IMG_SIZE || pic->height < MODEL_IMG_SIZE) {
+        ESP_LOGE("CAM", "Frame %dx%d is smaller than the crop", pic->width, pic->height);
         esp_camera_fb_return(pic);
         return false;
     }
 
-    memcpy(img.data, pic->buf, pic->len);
+    int x0, y0;
+    frame::center_crop_origin(pic->width, pic->height, MODEL_IMG_SIZE, x0, y0);
+    frame::crop_rgb565_to_rgb888(pic->buf, pic->width, x0, y0, MODEL_IMG_SIZE, MODEL_IMG_SIZE,
+                                 static_cast<uint8_t *>(cropped_img.data));
     esp_camera_fb_return(pic);
+    return true;
+}
 
-    // RGB565 -> RGB888 (ohne Crop)
-    dl::image::img_t rgb888_img;
-    rgb888_img.height = img.height;
-    rgb888_img.width = img.width;
-    rgb888_img.pix_type = dl::image::DL_IMAGE_PIX_TYPE_RGB888;
-    rgb888_img.data = malloc(img.width * img.height * 3);
-    if (!rgb888_img.data) {
-        ESP_LOGE("MEM", "Failed to allocate rgb888 buffer");
-        free(img.data);
-        return false;
-    }
-    dl::image::RGB5652RGB888<true, false> converter;
-    uint8_t* src = (uint8_t*)img.data;
-    uint8_t* dst = (uint8_t*)rgb888_img.data;
-    for (int i = 0; i < img.width * img.height; ++i) {
-        converter(src, dst);
-        src += 2;
-        dst += 3;
-    }
-
-    // Crop auf 224x224
+// Puffer für das 224x224 RGB888 Bild einmalig im PSRAM anlegen
+static bool alloc_cropped_image(dl::image::img_t &cropped_img) {
     cropped_img.height = MODEL_IMG_SIZE;
     cropped_img.width = MODEL_IMG_SIZE;
     cropped_img.pix_type = dl::image::DL_IMAGE_PIX_TYPE_RGB888;
-    cropped_img.data = malloc(MODEL_IMG_SIZE * MODEL_IMG_SIZE * 3);
+    cropped_img.data = heap_caps_aligned_alloc(16, MODEL_IMG_SIZE * MODEL_IMG_SIZE * 3, MALLOC_CAP_SPIRAM);
     if (!cropped_img.data) {
         ESP_LOGE("MEM", "Failed to allocate cropped buffer");
-        free(img.data);
-        free(rgb888_img.data);
         return false;
     }
-    int x0 = (rgb888_img.width - MODEL_IMG_SIZE) / 2;
-    int y0 = (rgb888_img.height - MODEL_IMG_SIZE) / 2;
-    for (int y = 0; y < MODEL_IMG_SIZE; ++y) {
-        int src_y = y0 + y;
-        memcpy(
-            (uint8_t*)cropped_img.data + y * MODEL_IMG_SIZE * 3,
-            (uint8_t*)rgb888_img.data + (src_y * rgb888_img.width + x0) * 3,
-            MODEL_IMG_SIZE * 3);
-    }
-
-    free(img.data);
-    free(rgb888_img.data);
     return true;
 }
 
@@ -154,10 +125,14 @@ extern "C" void app_main(void)
 #endif
 
     
+    dl::image::img_t cropped_img;
+    if (!alloc_cropped_image(cropped_img)) {
+        return;
+    }
+
     while (true) {
         ESP_LOGI("MEM", "Free heap at start of loop: %lu bytes", esp_get_free_heap_size());
 
-        dl::image::img_t cropped_img;
         if (!capture_and_convert_image(cropped_img)) {
             ESP_LOGE("CAM", "Could not take or convert picture");
             vTaskDelay(pdMS_TO_TICKS(2000));
@@ -199,7 +174,6 @@ extern "C" void app_main(void)
         dl::cls::result_t dummy_result = {};
         sdcard::save_detected_jpeg(cropped_img, dummy_result, "/sdcard/bumblebee_detect");
         delete detect;
-        heap_caps_free(cropped_img.data);
 
         vTaskDelay(pdMS_TO_TICKS(2000));
     }
@@ -0,0 +1,112 @@
+#!/usr/bin/env python3
+"""Event-Log der Firmware (events.bin) nach CSV oder Parquet umwandeln.
+
+Format siehe main/include/event_log.hpp: 512-Byte-Blöcke mit Header und CRC-32,
+darin Records à 24 Byte. Blöcke mit falscher CRC (abgebrochener Schreibvorgang)
+werden übersprungen.
+
+    python3 decode_events.py events.bin -o events.csv
+    python3 decode_events.py events.bin -o events.parquet   # braucht pandas + pyarrow
+"""
+import argparse
+import csv
+import struct
+import sys
+import zlib
+
+BLOCK_SIZE = 512
+MAGIC = 0x56455342
+VERSION = 1
+HEADER = struct.Struct("<IHHII")
+RECORD = struct.Struct("<IIBBH12s")
+
+REC_SESSION, REC_DETECTION, REC_CROSSING = 1, 2, 3
+DIRECTIONS = {0: "einflug", 1: "ausflug"}
+
+COLUMNS = ["session", "unix_time_ms", "time_ms", "frame_id", "type", "track_id",
+           "x1", "y1", "x2", "y2", "score", "zone", "direction", "einflug", "ausflug"]
+
+
+def read_records(path):
+    """Liefert die Records aller gültigen Blöcke in Dateireihenfolge."""
+    skipped = 0
+    with open(path, "rb") as f:
+        index = 0
+        while True:
+            block = f.read(BLOCK_SIZE)
+            if len(block) < BLOCK_SIZE:
+                break
+            magic, version, num_records, seq, crc = HEADER.unpack_from(block)
+            zeroed = block[:12] + b"\0\0\0\0" + block[16:]
+            if magic != MAGIC or version != VERSION or seq != index or zlib.crc32(zeroed) != crc:
+                skipped += 1
+            else:
+                for i in range(num_records):
+                    yield RECORD.unpack_from(block, HEADER.size + i * RECORD.size)
+            index += 1
+    if skipped:
+        print(f"{skipped} Blöcke mit ungültigem Header oder CRC übersprungen", file=sys.stderr)
+
+
+def decode(path):
+    """Records in Zeilen mit den Spalten aus COLUMNS umwandeln."""
+    session = -1
+    unix_base_ms = None   # Wanduhr zu Beginn der Session, None ohne gestellte RTC
+    session_start = 0
+    wraps = 0
+    last_time = 0
+    for time_ms, frame_id, rtype, direction, track_id, payload in read_records(path):
+        if rtype == REC_SESSION:
+            unix_time, _, _ = struct.unpack("<III", payload)
+            session += 1
+            session_start = time_ms
+            unix_base_ms = unix_time * 1000 if unix_time else None
+            wraps = 0
+            last_time = time_ms
+            continue
+
+        # time_ms läuft nach 49,7 Tagen über
+        if time_ms < last_time and last_time - time_ms > 1 << 31:
+            wraps += 1
+        last_time = time_ms
+        time_ms += wraps << 32
+
+        row = dict.fromkeys(COLUMNS, "")
+        row.update(session=session, time_ms=time_ms, frame_id=frame_id, track_id=track_id)
+        if unix_base_ms is not None:
+            row["unix_time_ms"] = unix_base_ms + time_ms - session_start
+        if rtype == REC_DETECTION:
+            x1, y1, x2, y2, score, _ = struct.unpack("<hhhhHH", payload)
+            row.update(type="detection", x1=x1, y1=y1, x2=x2, y2=y2, score=round(score / 65535, 4))
+        elif rtype == REC_CROSSING:
+            # Zählerstände gelten pro Zone; zone ist der Index in zones.txt (0 = Standardlinie)
+            einflug, ausflug, zone, _ = struct.unpack("<iiHH", payload)
+            row.update(type="crossing", zone=zone, direction=DIRECTIONS.get(direction, direction),
+                       einflug=einflug, ausflug=ausflug)
+        else:
+            row["type"] = f"unknown({rtype})"
+        yield row
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log", help="events.bin von der SD-Karte")
+    parser.add_argument("-o", "--output", help="Ziel .csv oder .parquet (Standard: CSV auf stdout)")
+    args = parser.parse_args()
+
+    rows = decode(args.log)
+    if args.output and args.output.endswith(".parquet"):
+        import pandas as pd
+        pd.DataFrame(list(rows), columns=COLUMNS).to_parquet(args.output, index=False)
+        return
+
+    out = open(args.output, "w", newline="") if args.output else sys.stdout
+    writer = csv.DictWriter(out, fieldnames=COLUMNS)
+    writer.writeheader()
+    writer.writerows(rows)
+    if out is not sys.stdout:
+        out.close()
+
+
+if __name__ == "__main__":
+    main()
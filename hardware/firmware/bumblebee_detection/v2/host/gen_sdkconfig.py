@@ -0,0 +1,178 @@
+#!/usr/bin/env python3
+"""sdkconfig.h für den Host-Build aus den Defaults der Kconfig-Dateien erzeugen.
+
+So gelten auf dem Host dieselben Defaults wie in einem frischen `idf.py menuconfig`,
+ohne dass eine Kopie von Hand nachgezogen werden muss. Symbole außerhalb der
+Dateien (SOC_*, IDF_TARGET_*, PM_ENABLE, ...) gelten als nicht gesetzt, Optionen,
+die davon abhängen, fehlen also wie auf einem Target ohne diese Hardware.
+
+    python3 gen_sdkconfig.py ../main/Kconfig.projbuild ../main/frame_convert/Kconfig -o build/config/sdkconfig.h
+
+Mit --set NAME=WERT wird ein Symbol abweichend vom Default gesetzt, z. B.
+--set BEESENSE_FAST_KERNELS=n für die skalaren Referenz-Kernels.
+"""
+import argparse
+import os
+import re
+import shlex
+import sys
+
+
+class Symbol:
+    def __init__(self, name):
+        self.name = name
+        self.type = None
+        self.defaults = []   # (Wert, Bedingung oder None)
+        self.depends = []    # Bedingungen aus depends on und umgebenden if-Blöcken
+        self.choice = None
+
+
+class Choice:
+    def __init__(self):
+        self.default = None
+        self.members = []
+
+
+def parse(path):
+    """Liest config-, choice- und if-Blöcke, Menüs sind für die Werte egal."""
+    symbols = []
+    conditions = []  # offene if-Blöcke
+    choice = None
+    current = None
+    with open(path, encoding="utf-8") as f:
+        lines = f.readlines()
+    in_help = False
+    help_indent = 0
+    for raw in lines:
+        line = raw.rstrip("\n")
+        stripped = line.strip()
+        indent = len(line) - len(line.lstrip())
+        if in_help:
+            if not stripped or indent > help_indent:
+                continue
+            in_help = False
+        if not stripped or stripped.startswith("#"):
+            continue
+        keyword, _, rest = stripped.partition(" ")
+        rest = rest.strip()
+        if keyword == "config":
+            current = Symbol(rest)
+            current.depends = list(conditions)
+            current.choice = choice
+            if choice:
+                choice.members.append(current)
+            symbols.append(current)
+        elif keyword == "choice":
+            choice = Choice()
+            current = None
+        elif keyword == "endchoice":
+            choice = None
+            current = None
+        elif keyword == "if":
+            conditions.append(rest)
+        elif keyword == "endif":
+            conditions.pop()
+        elif keyword in ("menu", "endmenu", "comment"):
+            current = None
+        elif keyword in ("bool", "int", "string", "hex") and current:
+            current.type = keyword
+        elif keyword == "default":
+            value, cond = split_condition(rest)
+            if current:
+                current.defaults.append((value, cond))
+            elif choice:
+                choice.default = value
+        elif keyword == "depends" and current:
+            current.depends.append(rest[len("on"):].strip())
+        elif keyword in ("help", "---help---"):
+            in_help = True
+            help_indent = indent
+    return symbols
+
+
+def split_condition(text):
+    """'20000 if BEESENSE_SD_SPI' -> ('20000', 'BEESENSE_SD_SPI')"""
+    tokens = shlex.split(text, posix=False)
+    if "if" in tokens:
+        i = tokens.index("if")
+        return " ".join(tokens[:i]), " ".join(tokens[i + 1:])
+    return text, None
+
+
+def evaluate(expr, values):
+    """Kconfig-Ausdruck mit &&, ||, ! und Klammern; unbekannte Symbole sind n."""
+    if expr is None:
+        return True
+    py = re.sub(r"[A-Za-z_][A-Za-z0-9_]*",
+                lambda m: "True" if values.get(m.group(0), "n") not in ("n", None) else "False", expr)
+    py = py.replace("&&", " and ").replace("||", " or ")
+    py = re.sub(r"!(?!=)", " not ", py)
+    return eval(py, {"__builtins__": {}})
+
+
+def resolve(symbols, overrides):
+    values = {}
+    # Abhängigkeiten zeigen in der Datei nach oben oder unten, also bis zum Fixpunkt
+    for _ in range(len(symbols) + 1):
+        changed = False
+        for sym in symbols:
+            value = None
+            if sym.name in overrides:
+                value = overrides[sym.name]
+            elif all(evaluate(d, values) for d in sym.depends):
+                if sym.choice:
+                    visible = [m for m in sym.choice.members if all(evaluate(d, values) for d in m.depends)]
+                    chosen = next((m for m in visible if m.name == sym.choice.default), visible[0] if visible else None)
+                    value = "y" if chosen is sym else "n"
+                else:
+                    value = next((v for v, cond in sym.defaults if evaluate(cond, values)), None)
+                    if value is None and sym.type == "bool":
+                        value = "n"
+            if values.get(sym.name) != value:
+                values[sym.name] = value
+                changed = True
+        if not changed:
+            return values
+    sys.exit("Kconfig-Abhängigkeiten ohne Fixpunkt")
+
+
+def render(symbols, values, source):
+    out = ["#pragma once", "",
+           f"// Erzeugt von host/gen_sdkconfig.py aus {source}, nicht von Hand ändern.", ""]
+    for sym in symbols:
+        value = values.get(sym.name)
+        if value is None or (sym.type == "bool" and value == "n"):
+            continue
+        # Strings stehen in Kconfig schon in Anführungszeichen
+        out.append(f"#define CONFIG_{sym.name} {'1' if sym.type == 'bool' else value}")
+    return "\n".join(out) + "\n"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("kconfig", nargs="+", help="Kconfig-Dateien, in dieser Reihenfolge gelesen")
+    parser.add_argument("-o", "--output", required=True)
+    parser.add_argument("--set", action="append", default=[], metavar="NAME=WERT",
+                        help="Symbol abweichend vom Default setzen")
+    args = parser.parse_args()
+
+    overrides = {}
+    for item in args.set:
+        name, sep, value = item.partition("=")
+        if not sep:
+            sys.exit(f"--set {item}: erwartet NAME=WERT")
+        overrides[name] = value
+
+    symbols = [sym for path in args.kconfig for sym in parse(path)]
+    unknown = set(overrides) - {sym.name for sym in symbols}
+    if unknown:
+        sys.exit(f"Unbekannte Symbole: {', '.join(sorted(unknown))}")
+    values = resolve(symbols, overrides)
+    v2_dir = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+    text = render(symbols, values, ", ".join(os.path.relpath(p, v2_dir) for p in args.kconfig))
+    with open(args.output, "w", encoding="utf-8") as f:
+        f.write(text)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,69 @@
+#include "jpeg_io.hpp"
+
+#include <cstdio>
+#include <jpeglib.h>
+
+namespace jpeg_io {
+
+bool read(const char *path, std::vector<uint8_t> &rgb888, int &width, int &height) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        std::fprintf(stderr, "Failed to open %s\n", path);
+        return false;
+    }
+
+    jpeg_decompress_struct cinfo;
+    jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_decompress(&cinfo);
+    jpeg_stdio_src(&cinfo, f);
+    jpeg_read_header(&cinfo, TRUE);
+    cinfo.out_color_space = JCS_RGB;
+    jpeg_start_decompress(&cinfo);
+
+    width = cinfo.output_width;
+    height = cinfo.output_height;
+    rgb888.resize(size_t(width) * height * 3);
+    while (cinfo.output_scanline < cinfo.output_height) {
+        JSAMPROW row = &rgb888[size_t(cinfo.output_scanline) * width * 3];
+        jpeg_read_scanlines(&cinfo, &row, 1);
+    }
+
+    jpeg_finish_decompress(&cinfo);
+    jpeg_destroy_decompress(&cinfo);
+    fclose(f);
+    return true;
+}
+
+bool write(const char *path, const uint8_t *rgb888, int width, int height, int quality) {
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        std::fprintf(stderr, "Failed to open %s\n", path);
+        return false;
+    }
+
+    jpeg_compress_struct cinfo;
+    jpeg_error_mgr jerr;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    jpeg_stdio_dest(&cinfo, f);
+    cinfo.image_width = width;
+    cinfo.image_height = height;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+
+    while (cinfo.next_scanline < cinfo.image_height) {
+        JSAMPROW row = const_cast<uint8_t *>(&rgb888[size_t(cinfo.next_scanline) * width * 3]);
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    fclose(f);
+    return true;
+}
+
+} // namespace jpeg_io
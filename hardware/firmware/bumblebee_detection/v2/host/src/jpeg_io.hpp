@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+namespace jpeg_io {
+
+// Decode a JPEG file into packed RGB888
+bool read(const char *path, std::vector<uint8_t> &rgb888, int &width, int &height);
+
+// Encode packed RGB888 into a JPEG file
+bool write(const char *path, const uint8_t *rgb888, int width, int height, int quality);
+
+} // namespace jpeg_io
@@ -0,0 +1,534 @@
+// Offline replay of the v2 detection pipeline on the host.
+//
+// Runs recorded JPEGs and detections through the same modules as the firmware:
+// ROI crop/scale, motion gate, tracker, zone counter, save policy and file naming.
+// The camera, the detector and the SD card are replaced by the interfaces below.
+//
+//   beesense_replay [options] <image_dir>...
+//
+// Detections are read from YOLO label files (class cx cy w h [score], normalized),
+// by default from the matching labels/ directory next to images/.
+// With --events the detections and crossings go into the firmware's binary event
+// log, at a nominal 100 ms per frame.
+// With --config the firmware's settings file is read first, explicit options win over it.
+// With --schedule the frame scheduler runs on that simulated clock and the frames
+// it would not have captured are skipped, which shows what the quiet intervals cost.
+// With --expect E,A the exit code is 1 unless the totals are E Einflüge and A Ausflüge,
+// which is how ctest checks the recorded sequences.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <strings.h>
+#include <string>
+#include <vector>
+
+#include "sdkconfig.h"
+#include "frame_convert.hpp"
+#include "motion_gate.hpp"
+#include "tracker.hpp"
+#include "zone_counter.hpp"
+#include "settings.hpp"
+#include "save_policy.hpp"
+#include "file_naming.hpp"
+#include "profiler.hpp"
+#include "event_log.hpp"
+#include "frame_scheduler.hpp"
+#include "jpeg_io.hpp"
+
+static constexpr int MODEL_IMG_SIZE = 224;
+static constexpr int MAX_DETECTIONS = 10; // pipeline::MAX_DETECTIONS
+static constexpr uint32_t FRAME_INTERVAL_MS = 100;
+
+// --------- Interfaces ----------------------------------
+
+// Camera: delivers big-endian RGB565 frames like esp_camera_fb_get()
+struct camera_frame_t {
+    std::string name;
+    const uint8_t *buf;
+    int width;
+    int height;
+};
+
+class FrameSource {
+public:
+    virtual ~FrameSource() = default;
+    virtual bool next(camera_frame_t &frame) = 0;
+};
+
+// Detector: model results for a frame, in model input coordinates
+class DetectionSource {
+public:
+    virtual ~DetectionSource() = default;
+    virtual int detect(const camera_frame_t &frame, const frame::rect_t &roi, tracker::box_t *boxes, int max_boxes) = 0;
+};
+
+// SD card: stores a saved frame
+class FrameSink {
+public:
+    virtual ~FrameSink() = default;
+    virtual bool save(const uint8_t *rgb888, int width, int height) = 0;
+};
+
+// --------- Implementations ----------------------------------
+
+// JPEG files of one or more directories, in file name order (the names are timestamps)
+class JpegDirSource : public FrameSource {
+public:
+    explicit JpegDirSource(const std::vector<std::string> &dirs) {
+        for (const std::string &dir : dirs) {
+            std::vector<std::string> names;
+            DIR *d = opendir(dir.c_str());
+            if (!d) {
+                std::fprintf(stderr, "Cannot open %s\n", dir.c_str());
+                continue;
+            }
+            while (struct dirent *entry = readdir(d)) {
+                const char *dot = strrchr(entry->d_name, '.');
+                if (dot && (strcasecmp(dot, ".jpg") == 0 || strcasecmp(dot, ".jpeg") == 0)) {
+                    names.push_back(entry->d_name);
+                }
+            }
+            closedir(d);
+            std::sort(names.begin(), names.end());
+            for (const std::string &name : names) {
+                m_paths.push_back(dir + "/" + name);
+            }
+        }
+    }
+
+    size_t size() const { return m_paths.size(); }
+
+    bool next(camera_frame_t &frame) override {
+        while (m_next < m_paths.size()) {
+            const std::string &path = m_paths[m_next++];
+            std::vector<uint8_t> rgb888;
+            int width, height;
+            if (!jpeg_io::read(path.c_str(), rgb888, width, height)) {
+                continue;
+            }
+            // Pack to big-endian RGB565 as the camera delivers it
+            m_rgb565.resize(size_t(width) * height * 2);
+            frame::rgb888_to_rgb565(rgb888.data(), width * height, m_rgb565.data());
+            frame = {path, m_rgb565.data(), width, height};
+            return true;
+        }
+        return false;
+    }
+
+private:
+    std::vector<std::string> m_paths;
+    size_t m_next = 0;
+    std::vector<uint8_t> m_rgb565;
+};
+
+// YOLO label file per image: <labels>/<name>.txt, or .../labels/... for .../images/...
+class LabelDetections : public DetectionSource {
+public:
+    explicit LabelDetections(const char *labels_dir) : m_labels_dir(labels_dir ? labels_dir : "") {}
+
+    int detect(const camera_frame_t &frame, const frame::rect_t &roi, tracker::box_t *boxes, int max_boxes) override {
+        FILE *f = fopen(label_path(frame.name).c_str(), "r");
+        if (!f) {
+            return 0;
+        }
+        int n = 0;
+        char line[256];
+        while (n < max_boxes && fgets(line, sizeof(line), f)) {
+            int cls;
+            float cx, cy, w, h, score = 1.0f;
+            if (sscanf(line, "%d %f %f %f %f %f", &cls, &cx, &cy, &w, &h, &score) < 5 || cls != 0) {
+                continue;
+            }
+            // Camera pixels -> model input pixels of the ROI
+            const float x1 = (cx - w / 2) * frame.width - roi.x;
+            const float y1 = (cy - h / 2) * frame.height - roi.y;
+            const float x2 = (cx + w / 2) * frame.width - roi.x;
+            const float y2 = (cy + h / 2) * frame.height - roi.y;
+            boxes[n++] = {int(x1 * MODEL_IMG_SIZE / roi.w), int(y1 * MODEL_IMG_SIZE / roi.h),
+                          int(x2 * MODEL_IMG_SIZE / roi.w), int(y2 * MODEL_IMG_SIZE / roi.h), score};
+        }
+        fclose(f);
+        return n;
+    }
+
+private:
+    std::string label_path(const std::string &image_path) const {
+        const size_t slash = image_path.rfind('/');
+        const size_t dot = image_path.rfind('.');
+        const std::string stem = image_path.substr(slash + 1, dot - slash - 1);
+        if (!m_labels_dir.empty()) {
+            return m_labels_dir + "/" + stem + ".txt";
+        }
+        std::string dir = image_path.substr(0, slash);
+        const size_t images = dir.rfind("/images");
+        if (images != std::string::npos) {
+            dir.replace(images, 7, "/labels");
+        }
+        return dir + "/" + stem + ".txt";
+    }
+
+    std::string m_labels_dir;
+};
+
+// Writes saved frames with the firmware's file naming, or only counts them
+class JpegDirSink : public FrameSink {
+public:
+    explicit JpegDirSink(const char *out_dir) : m_out_dir(out_dir), m_namer(CONFIG_BEESENSE_SD_FILES_PER_DIR) {}
+
+    bool save(const uint8_t *rgb888, int width, int height) override {
+        if (!m_out_dir) {
+            return true;
+        }
+        char path[256];
+        if (!m_namer.next_file_path(m_out_dir, path, sizeof(path))) {
+            return false;
+        }
+        return jpeg_io::write(path, rgb888, width, height, 80);
+    }
+
+private:
+    const char *m_out_dir;
+    naming::FileNamer m_namer;
+};
+
+// --------- Replay ----------------------------------
+
+struct options_t {
+    std::vector<std::string> image_dirs;
+    const char *labels_dir = nullptr;
+    const char *out_dir = nullptr;
+    const char *events_path = nullptr;
+    const char *zones_path = nullptr;
+    const char *config_path = nullptr;
+    frame::rect_t roi = {CONFIG_BEESENSE_ROI_X, CONFIG_BEESENSE_ROI_Y, CONFIG_BEESENSE_ROI_WIDTH,
+                         CONFIG_BEESENSE_ROI_HEIGHT};
+    int line_y = -1;        // -1: count_line_y of the settings
+    float score_thr = -1.0f; // < 0: score_thr of the settings
+    bool motion_gate = CONFIG_BEESENSE_MOTION_GATE;
+    bool schedule = false;
+    int expect_einflug = -1; // -1: no check
+    int expect_ausflug = -1;
+};
+
+enum host_stage_t { CROP, MOTION, DETECT, TRACKING, POLICY, CONVERT, SAVE, NUM_HOST_STAGES };
+static const char *HOST_STAGE_NAMES[NUM_HOST_STAGES] = {
+    "crop", "motion", "detect(labels)", "tracking", "save_policy", "convert", "save",
+};
+
+class StageTimer {
+public:
+    StageTimer(profiler::Histogram &h) : m_h(h), m_start(std::chrono::steady_clock::now()) {}
+    ~StageTimer() {
+        const auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_start);
+        m_h.add(uint32_t(us.count()));
+    }
+
+private:
+    profiler::Histogram &m_h;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+static void usage(const char *argv0) {
+    std::fprintf(stderr,
+                 "usage: %s [--labels DIR] [--out DIR] [--events FILE] [--config FILE] [--roi X,Y,W,H] [--line Y] [--zones FILE] [--score S] [--no-motion] [--schedule] [--expect E,A] "
+                 "<image_dir>...\n",
+                 argv0);
+}
+
+static bool parse_args(int argc, char **argv, options_t &opt) {
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (strcmp(arg, "--labels") == 0 && has_value) {
+            opt.labels_dir = argv[++i];
+        } else if (strcmp(arg, "--out") == 0 && has_value) {
+            opt.out_dir = argv[++i];
+        } else if (strcmp(arg, "--events") == 0 && has_value) {
+            opt.events_path = argv[++i];
+        } else if (strcmp(arg, "--roi") == 0 && has_value) {
+            if (sscanf(argv[++i], "%d,%d,%d,%d", &opt.roi.x, &opt.roi.y, &opt.roi.w, &opt.roi.h) != 4) {
+                return false;
+            }
+        } else if (strcmp(arg, "--line") == 0 && has_value) {
+            opt.line_y = atoi(argv[++i]);
+        } else if (strcmp(arg, "--config") == 0 && has_value) {
+            opt.config_path = argv[++i];
+        } else if (strcmp(arg, "--zones") == 0 && has_value) {
+            opt.zones_path = argv[++i];
+        } else if (strcmp(arg, "--score") == 0 && has_value) {
+            opt.score_thr = float(atof(argv[++i]));
+        } else if (strcmp(arg, "--expect") == 0 && has_value) {
+            if (sscanf(argv[++i], "%d,%d", &opt.expect_einflug, &opt.expect_ausflug) != 2) {
+                return false;
+            }
+        } else if (strcmp(arg, "--no-motion") == 0) {
+            opt.motion_gate = false;
+        } else if (strcmp(arg, "--schedule") == 0) {
+            opt.schedule = true;
+        } else if (arg[0] == '-') {
+            return false;
+        } else {
+            opt.image_dirs.push_back(arg);
+        }
+    }
+    return !opt.image_dirs.empty();
+}
+
+int main(int argc, char **argv) {
+    options_t opt;
+    if (!parse_args(argc, argv, opt)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // Settings like on the SD card, then the command line on top
+    settings::settings_t cfg = settings::defaults();
+    if (opt.config_path && settings::load(opt.config_path, cfg) < 0) {
+        std::fprintf(stderr, "cannot read settings from %s\n", opt.config_path);
+        return 1;
+    }
+    if (opt.line_y < 0) {
+        opt.line_y = cfg.count_line_y;
+    }
+    if (opt.score_thr < 0.0f) {
+        opt.score_thr = cfg.score_thr;
+    }
+
+    JpegDirSource camera(opt.image_dirs);
+    LabelDetections detector(opt.labels_dir);
+    JpegDirSink storage(opt.out_dir);
+
+    motion::MotionGate motion_gate({
+        .block_size = CONFIG_BEESENSE_MOTION_BLOCK_SIZE,
+        .cell_threshold = CONFIG_BEESENSE_MOTION_CELL_THRESHOLD,
+        .min_changed_cells = CONFIG_BEESENSE_MOTION_MIN_CELLS,
+        .background_shift = CONFIG_BEESENSE_MOTION_BACKGROUND_SHIFT,
+        .force_interval = CONFIG_BEESENSE_MOTION_FORCE_INTERVAL,
+    });
+    tracker::Tracker tracks({
+        .min_iou = CONFIG_BEESENSE_TRACK_MIN_IOU_PERCENT / 100.0f,
+        .max_distance = CONFIG_BEESENSE_TRACK_MAX_DISTANCE,
+        .min_hits = CONFIG_BEESENSE_TRACK_MIN_HITS,
+        .max_age = CONFIG_BEESENSE_TRACK_MAX_AGE,
+    });
+    // Zones from the file like on the SD card, otherwise the single line. With --config
+    // a missing zones_path falls back to the line as on the device.
+    counting::ZoneCounter zone_counter;
+    counting::zone_t zones[counting::MAX_ZONES];
+    int num_zones = 1;
+    zones[0] = counting::horizontal_line(opt.line_y);
+    if (opt.zones_path) {
+        num_zones = counting::load_zones(opt.zones_path, zones, counting::MAX_ZONES);
+        if (num_zones < 0) {
+            std::fprintf(stderr, "cannot load zones from %s\n", opt.zones_path);
+            return 1;
+        }
+    } else if (opt.config_path) {
+        num_zones = counting::load_zones(cfg.zones_path, zones, counting::MAX_ZONES);
+        if (num_zones <= 0) {
+            num_zones = 1;
+            zones[0] = counting::horizontal_line(opt.line_y);
+        }
+    }
+    if (!zone_counter.set_zones(zones, num_zones)) {
+        return 1;
+    }
+    save_policy::SavePolicy policy({
+        .modes = save_policy::SAVE_DETECTIONS | save_policy::SAVE_CROSSINGS,
+        .min_score = cfg.save_min_score,
+        .pre_roll = CONFIG_BEESENSE_SAVE_PRE_ROLL,
+        .post_roll = CONFIG_BEESENSE_SAVE_POST_ROLL,
+        .keyframe_interval = CONFIG_BEESENSE_SAVE_KEYFRAME_INTERVAL,
+    });
+
+    scheduler::Scheduler frame_scheduler({
+        .active_interval_ms = cfg.active_interval_ms,
+        .quiet_after_ms = cfg.quiet_after_s * 1000,
+        .quiet_interval_ms = cfg.quiet_interval_ms,
+        .night_start_hour = cfg.night_start_hour,
+        .night_end_hour = cfg.night_end_hour,
+        .night_interval_ms = cfg.night_interval_ms,
+        .power_down_min_ms = cfg.power_down_min_ms,
+    });
+    uint32_t next_capture_ms = 0, last_activity_ms = 0, skipped = 0;
+    bool power_cycled = false;
+
+    eventlog::EventLog event_log(CONFIG_BEESENSE_EVENT_LOG_SYNC_MS);
+    if (opt.events_path && !event_log.open(opt.events_path, 0, 0)) {
+        return 1;
+    }
+
+    std::vector<uint8_t> model_img(MODEL_IMG_SIZE * MODEL_IMG_SIZE * 2); // RGB565 like on the S3
+    std::vector<uint8_t> rgb888_img(MODEL_IMG_SIZE * MODEL_IMG_SIZE * 3);
+    profiler::Histogram stages[NUM_HOST_STAGES];
+    uint32_t frames = 0, inferred = 0, gated_with_labels = 0, detections = 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    camera_frame_t cam;
+    while (camera.next(cam)) {
+        frames++;
+        const uint32_t time_ms = frames * FRAME_INTERVAL_MS;
+        if (opt.schedule) {
+            // The scheduler decides before the capture how long to wait, frames in that gap are lost
+            if (time_ms < next_capture_ms) {
+                skipped++;
+                continue;
+            }
+            if (power_cycled && opt.motion_gate) {
+                motion_gate.reset(); // the camera was off, like camera::set_power on the device
+            }
+            const scheduler::plan_t plan = frame_scheduler.next(time_ms, last_activity_ms, -1);
+            next_capture_ms = time_ms + plan.delay_ms;
+            // After a power-down the settle frames are dropped as well
+            power_cycled = plan.delay_ms > 0 && plan.power_down;
+            if (power_cycled) {
+                next_capture_ms += CONFIG_BEESENSE_SCHEDULER_POWER_UP_SETTLE_FRAMES * FRAME_INTERVAL_MS;
+            }
+        }
+
+        frame::rect_t roi = opt.roi;
+        if (cam.width < roi.w || cam.height < roi.h) {
+            std::fprintf(stderr, "%s: frame %dx%d is smaller than the ROI\n", cam.name.c_str(), cam.width, cam.height);
+            continue;
+        }
+        frame::clamp_rect(roi, cam.width, cam.height);
+        {
+            StageTimer t(stages[CROP]);
+            if (roi.w == MODEL_IMG_SIZE && roi.h == MODEL_IMG_SIZE) {
+                frame::crop_rgb565(cam.buf, cam.width, roi.x, roi.y, roi.w, roi.h, model_img.data());
+            } else {
+                frame::resize_rgb565(cam.buf, cam.width, roi.x, roi.y, roi.w, roi.h,
+                                     model_img.data(), MODEL_IMG_SIZE, MODEL_IMG_SIZE);
+            }
+        }
+
+        bool run_model = true;
+        bool motion = false;
+        if (opt.motion_gate) {
+            StageTimer t(stages[MOTION]);
+            motion = motion_gate.update(model_img.data(), MODEL_IMG_SIZE, MODEL_IMG_SIZE, true);
+            run_model = motion || tracks.num_tracks() > 0;
+        }
+
+        tracker::box_t boxes[MAX_DETECTIONS];
+        int num_boxes = 0;
+        float max_score = 0.0f;
+        {
+            StageTimer t(stages[DETECT]);
+            tracker::box_t raw[MAX_DETECTIONS];
+            const int n = detector.detect(cam, roi, raw, MAX_DETECTIONS);
+            if (!run_model) {
+                gated_with_labels += n > 0;
+            } else {
+                inferred++;
+                for (int i = 0; i < n; ++i) {
+                    if (raw[i].score <= opt.score_thr) {
+                        continue;
+                    }
+                    // Model coordinates -> camera coordinates, as in app_main
+                    const tracker::box_t &b = raw[i];
+                    boxes[num_boxes++] = {roi.x + b.x1 * roi.w / MODEL_IMG_SIZE, roi.y + b.y1 * roi.h / MODEL_IMG_SIZE,
+                                          roi.x + b.x2 * roi.w / MODEL_IMG_SIZE, roi.y + b.y2 * roi.h / MODEL_IMG_SIZE,
+                                          b.score};
+                    max_score = std::max(max_score, b.score);
+                }
+            }
+        }
+        detections += num_boxes;
+
+        int crossings;
+        uint32_t track_ids[MAX_DETECTIONS];
+        {
+            StageTimer t(stages[TRACKING]);
+            tracks.update(boxes, num_boxes, track_ids);
+            crossings = zone_counter.update(tracks);
+        }
+        if (motion || num_boxes > 0 || tracks.num_tracks() > 0) {
+            last_activity_ms = time_ms;
+        }
+
+        for (int i = 0; i < num_boxes; ++i) {
+            const tracker::box_t &b = boxes[i];
+            event_log.detection(time_ms, frames, track_ids[i], b.x1, b.y1, b.x2, b.y2, b.score);
+        }
+        for (int i = 0; i < zone_counter.num_last_crossings(); ++i) {
+            const counting::crossing_t &c = zone_counter.last_crossing(i);
+            event_log.crossing(time_ms, frames, c.track_id, c.zone, c.direction, zone_counter.einflug(c.zone),
+                               zone_counter.ausflug(c.zone));
+        }
+        event_log.tick(time_ms);
+
+        save_policy::decision_t decision;
+        {
+            StageTimer t(stages[POLICY]);
+            decision = policy.evaluate({num_boxes, max_score, crossings});
+        }
+        if (decision.save) {
+            {
+                StageTimer t(stages[CONVERT]);
+                frame::crop_rgb565_to_rgb888(model_img.data(), MODEL_IMG_SIZE, 0, 0, MODEL_IMG_SIZE, MODEL_IMG_SIZE,
+                                             rgb888_img.data());
+            }
+            StageTimer t(stages[SAVE]);
+            storage.save(rgb888_img.data(), MODEL_IMG_SIZE, MODEL_IMG_SIZE);
+        }
+    }
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const motion::stats_t &mg = motion_gate.stats();
+    const tracker::stats_t &tr = tracks.stats();
+    const save_policy::stats_t &sp = policy.stats();
+    std::printf("frames        %u in %.3f s (%.1f fps, JPEG decode included)\n", frames, seconds,
+                seconds > 0 ? frames / seconds : 0.0);
+    std::printf("inferred      %u (motion %u, forced %u), gated frames with labels %u\n", inferred, mg.motion,
+                mg.forced, gated_with_labels);
+    std::printf("detections    %u, tracks created %u, confirmed %u\n", detections, tr.created, tr.confirmed);
+    std::printf("counts        Einflüge %d, Ausflüge %d\n", zone_counter.einflug(), zone_counter.ausflug());
+    if (zone_counter.num_zones() > 1) {
+        for (int z = 0; z < zone_counter.num_zones(); ++z) {
+            std::printf("  %-12s Einflüge %d, Ausflüge %d\n", zone_counter.zone(z).name, zone_counter.einflug(z),
+                        zone_counter.ausflug(z));
+        }
+    }
+    std::printf("saved         %u of %u frames (%u events, %u keyframes)\n", sp.saved, sp.frames, sp.events,
+                sp.keyframes);
+    if (opt.schedule) {
+        const scheduler::stats_t &fs = frame_scheduler.stats();
+        std::printf("scheduler     %u frames skipped, %u mode switches\n", skipped, fs.switches);
+        for (int m = 0; m < scheduler::MODE_COUNT; ++m) {
+            const scheduler::mode_t mode = scheduler::mode_t(m);
+            std::printf("  %-6s      %u frames, %.1f s, duty cycle %.1f %%\n", scheduler::mode_name(mode),
+                        fs.frames[m], fs.mode_ms[m] / 1000.0, frame_scheduler.duty_cycle(mode) * 100.0f);
+        }
+    }
+    if (event_log.is_open()) {
+        event_log.close();
+        const eventlog::stats_t &ev = event_log.stats();
+        std::printf("event log     %u records, %u blocks, %u syncs, %u errors, %u blocks lost\n", ev.records,
+                    ev.blocks, ev.syncs, ev.errors, ev.lost);
+    }
+    std::printf("%-16s %8s %8s %8s %8s %8s\n", "stage (us)", "count", "p50", "p95", "p99", "max");
+    for (int i = 0; i < NUM_HOST_STAGES; ++i) {
+        const profiler::Histogram &h = stages[i];
+        if (h.count() == 0) {
+            continue;
+        }
+        std::printf("%-16s %8u %8u %8u %8u %8u\n", HOST_STAGE_NAMES[i], h.count(), h.percentile(0.5f),
+                    h.percentile(0.95f), h.percentile(0.99f), h.max());
+    }
+    if (frames == 0) {
+        std::fprintf(stderr, "no frames replayed\n");
+        return 1;
+    }
+    if (opt.expect_einflug >= 0 &&
+        (zone_counter.einflug() != opt.expect_einflug || zone_counter.ausflug() != opt.expect_ausflug)) {
+        std::fprintf(stderr, "expected Einflüge %d, Ausflüge %d\n", opt.expect_einflug, opt.expect_ausflug);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+// Minimal assertions for the host tests: CHECK logs the failed condition and keeps
+// going, the test's main returns check::result() so ctest sees every failure at once.
+
+#include <cstdio>
+
+namespace check {
+
+inline int &failures() {
+    static int count = 0;
+    return count;
+}
+
+inline int result() {
+    if (failures() > 0) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures());
+        return 1;
+    }
+    return 0;
+}
+
+} // namespace check
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            check::failures()++;                                                     \
+        }                                                                            \
+    } while (0)
+
+#define CHECK_EQ(a, b)                                                               \
+    do {                                                                             \
+        const long long check_a_ = (long long)(a), check_b_ = (long long)(b);        \
+        if (check_a_ != check_b_) {                                                  \
+            std::fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %lld != %lld\n",   \
+                         __FILE__, __LINE__, #a, #b, check_a_, check_b_);            \
+            check::failures()++;                                                     \
+        }                                                                            \
+    } while (0)
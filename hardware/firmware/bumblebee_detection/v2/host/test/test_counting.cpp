@@ -0,0 +1,289 @@
+// Tracker and ZoneCounter on scripted detection sequences with known counts:
+// crossings in both directions, two bees passing each other, dropouts up to and
+// beyond max_age, centers landing on the line, that the ids of expired tracks are
+// not handed out again, and the zone file parser.
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "sdkconfig.h"
+#include "tracker.hpp"
+#include "zone_counter.hpp"
+#include "check.hpp"
+
+static constexpr int LINE_Y = 120;
+static constexpr int BOX = 20; // bee size in camera pixels
+
+static const tracker::config_t TRACKER_CFG = {
+    .min_iou = CONFIG_BEESENSE_TRACK_MIN_IOU_PERCENT / 100.0f,
+    .max_distance = CONFIG_BEESENSE_TRACK_MAX_DISTANCE,
+    .min_hits = CONFIG_BEESENSE_TRACK_MIN_HITS,
+    .max_age = CONFIG_BEESENSE_TRACK_MAX_AGE,
+};
+
+struct bee_t {
+    int cx, cy;
+};
+
+// Tracker plus counter with the default horizontal line, fed one frame at a time
+class Scene {
+public:
+    Scene() : m_tracks(TRACKER_CFG) {
+        const counting::zone_t line = counting::horizontal_line(LINE_Y);
+        m_counter.set_zones(&line, 1);
+    }
+
+    // Detections of one frame; returns the track id of each one
+    std::vector<uint32_t> frame(const std::vector<bee_t> &bees) {
+        tracker::box_t boxes[tracker::MAX_DETECTIONS];
+        for (size_t i = 0; i < bees.size(); ++i) {
+            boxes[i] = {bees[i].cx - BOX / 2, bees[i].cy - BOX / 2, bees[i].cx + BOX / 2, bees[i].cy + BOX / 2, 0.9f};
+        }
+        std::vector<uint32_t> ids(bees.size());
+        m_tracks.update(boxes, int(bees.size()), ids.data());
+        m_counter.update(m_tracks);
+        return ids;
+    }
+
+    // A single bee moving from y_from to y_to in steps of dy; returns its ids per frame
+    std::vector<uint32_t> walk(int x, int y_from, int y_to, int dy) {
+        std::vector<uint32_t> ids;
+        for (int y = y_from; dy > 0 ? y <= y_to : y >= y_to; y += dy) {
+            ids.push_back(frame({{x, y}})[0]);
+        }
+        return ids;
+    }
+
+    void empty_frames(int n) {
+        for (int i = 0; i < n; ++i) {
+            frame({});
+        }
+    }
+
+    int einflug() const { return m_counter.einflug(); }
+    int ausflug() const { return m_counter.ausflug(); }
+    const tracker::Tracker &tracks() const { return m_tracks; }
+
+private:
+    tracker::Tracker m_tracks;
+    counting::ZoneCounter m_counter;
+};
+
+static bool all_equal(const std::vector<uint32_t> &ids) {
+    for (uint32_t id : ids) {
+        if (id == 0 || id != ids[0]) {
+            return false;
+        }
+    }
+    return !ids.empty();
+}
+
+static void test_einflug() {
+    Scene s;
+    const std::vector<uint32_t> ids = s.walk(100, 170, 70, -10); // bottom to top
+    CHECK(all_equal(ids));
+    CHECK_EQ(s.einflug(), 1);
+    CHECK_EQ(s.ausflug(), 0);
+}
+
+static void test_ausflug() {
+    Scene s;
+    CHECK(all_equal(s.walk(100, 70, 170, 10))); // top to bottom
+    CHECK_EQ(s.einflug(), 0);
+    CHECK_EQ(s.ausflug(), 1);
+}
+
+static void test_back_and_forth() {
+    // Up across the line, turn around and back down: one crossing each way
+    Scene s;
+    std::vector<uint32_t> ids = s.walk(100, 160, 90, -10);
+    const std::vector<uint32_t> back = s.walk(100, 100, 160, 10);
+    ids.insert(ids.end(), back.begin(), back.end());
+    CHECK(all_equal(ids));
+    CHECK_EQ(s.einflug(), 1);
+    CHECK_EQ(s.ausflug(), 1);
+}
+
+static void test_hovering_on_line() {
+    // Moving sideways just below the line never crosses it
+    Scene s;
+    for (int x = 60; x <= 200; x += 10) {
+        s.frame({{x, LINE_Y + 2}});
+    }
+    CHECK_EQ(s.einflug() + s.ausflug(), 0);
+}
+
+static void test_touching_line() {
+    // A center that lands exactly on the line counts in the direction it came from,
+    // moving off the line again counts nothing (like the former y_line test)
+    Scene up;
+    up.walk(100, 160, LINE_Y, -10);
+    up.walk(100, LINE_Y + 10, 160, 10);
+    CHECK_EQ(up.einflug(), 1);
+    CHECK_EQ(up.ausflug(), 0);
+
+    Scene down;
+    down.walk(100, 80, LINE_Y, 10);
+    down.walk(100, LINE_Y - 10, 80, -10);
+    CHECK_EQ(down.einflug(), 0);
+    CHECK_EQ(down.ausflug(), 1);
+
+    // Through the line with a stop on it counts once
+    Scene through;
+    through.walk(100, 160, LINE_Y, -10);
+    through.frame({{100, LINE_Y}});
+    through.walk(100, LINE_Y - 10, 80, -10);
+    CHECK_EQ(through.einflug(), 1);
+    CHECK_EQ(through.ausflug(), 0);
+}
+
+static void test_bees_passing() {
+    // A flies in while B flies out 30 px beside it, they pass at the line
+    Scene s;
+    std::vector<uint32_t> a_ids, b_ids;
+    for (int step = 0; step <= 10; ++step) {
+        const int a_y = 170 - step * 10;
+        const int b_y = 70 + step * 10;
+        const std::vector<uint32_t> ids = s.frame({{100, a_y}, {130, b_y}});
+        a_ids.push_back(ids[0]);
+        b_ids.push_back(ids[1]);
+    }
+    CHECK(all_equal(a_ids));
+    CHECK(all_equal(b_ids));
+    CHECK(a_ids[0] != b_ids[0]);
+    CHECK_EQ(s.einflug(), 1);
+    CHECK_EQ(s.ausflug(), 1);
+}
+
+static void test_bees_side_by_side() {
+    // Two bees fly in next to each other, both are counted
+    Scene s;
+    std::vector<uint32_t> a_ids, b_ids;
+    for (int y = 170; y >= 70; y -= 10) {
+        const std::vector<uint32_t> ids = s.frame({{100, y}, {125, y + 4}});
+        a_ids.push_back(ids[0]);
+        b_ids.push_back(ids[1]);
+    }
+    CHECK(all_equal(a_ids));
+    CHECK(all_equal(b_ids));
+    CHECK(a_ids[0] != b_ids[0]);
+    CHECK_EQ(s.einflug(), 2);
+    CHECK_EQ(s.ausflug(), 0);
+}
+
+static void test_dropout_within_max_age() {
+    // Lost for max_age frames while crossing the line: same track, counted once
+    Scene s;
+    std::vector<uint32_t> ids = s.walk(100, 160, 136, -8);
+    s.empty_frames(TRACKER_CFG.max_age);
+    const std::vector<uint32_t> after = s.walk(100, 112, 80, -8);
+    ids.insert(ids.end(), after.begin(), after.end());
+    CHECK(all_equal(ids));
+    CHECK_EQ(s.einflug(), 1);
+    CHECK_EQ(s.ausflug(), 0);
+}
+
+static void test_dropout_beyond_max_age() {
+    // Lost for one frame more: the track expires, the bee comes back as a new track
+    // on the other side of the line and nothing is counted
+    Scene s;
+    const std::vector<uint32_t> before = s.walk(100, 160, 136, -8);
+    s.empty_frames(TRACKER_CFG.max_age + 1);
+    CHECK_EQ(s.tracks().num_tracks(), 0);
+    const std::vector<uint32_t> after = s.walk(100, 112, 80, -8);
+    CHECK(all_equal(before));
+    CHECK(all_equal(after));
+    CHECK(after[0] > before[0]);
+    CHECK_EQ(s.einflug() + s.ausflug(), 0);
+}
+
+static void test_ids_not_reused() {
+    // Bees appear and vanish at the same spot; every appearance gets a new id
+    Scene s;
+    uint32_t last_id = 0;
+    for (int i = 0; i < 40; ++i) {
+        const std::vector<uint32_t> ids = s.walk(100, 60, 70, 10);
+        CHECK(all_equal(ids));
+        CHECK(ids[0] > last_id);
+        last_id = ids[0];
+        s.empty_frames(TRACKER_CFG.max_age + 1);
+    }
+    CHECK_EQ(s.tracks().stats().created, 40);
+    CHECK_EQ(s.tracks().stats().expired, 40);
+}
+
+static void test_single_detection_not_counted() {
+    // A false positive below the line and one above it in the next frame are too far
+    // apart to be one track, and neither is confirmed
+    Scene s;
+    s.frame({{100, 170}});
+    s.frame({{100, 60}});
+    s.empty_frames(TRACKER_CFG.max_age + 1);
+    CHECK_EQ(s.einflug() + s.ausflug(), 0);
+    CHECK_EQ(s.tracks().stats().confirmed, 0);
+}
+
+static void test_parse_zones() {
+    counting::zone_t zones[counting::MAX_ZONES];
+    const char *text =
+        "# entrance from the left\n"
+        "line links 20 60 20 200 1 0\n"
+        "\n"
+        "poly flugloch in 140 90 220 90 220 150 140 150  # box\n"
+        "poly rand out 0 0 10 0 10 10\n";
+    CHECK_EQ(counting::parse_zones(text, zones, counting::MAX_ZONES), 3);
+    CHECK_EQ(zones[0].type, counting::ZONE_LINE);
+    CHECK_EQ(zones[0].points[1].y, 200);
+    CHECK_EQ(zones[0].dx, 1);
+    CHECK_EQ(zones[1].type, counting::ZONE_POLYGON);
+    CHECK_EQ(zones[1].num_points, 4);
+    CHECK(zones[1].enter_is_einflug);
+    CHECK(!zones[2].enter_is_einflug);
+
+    // The last line may lack its newline, an empty file has no zones
+    CHECK_EQ(counting::parse_zones("line a 0 0 10 0 0 1", zones, counting::MAX_ZONES), 1);
+    CHECK_EQ(counting::parse_zones("", zones, counting::MAX_ZONES), 0);
+
+    const char *invalid[] = {
+        "circle c 1 2 3\n",                      // unknown type
+        "line\n",                                // no name
+        "line a 0 0 10 0 0\n",                   // missing dy
+        "line a 0 0 10 0 0 1 5\n",               // trailing number
+        "line a 0 0 10 x 0 1\n",                 // not a number
+        "line a 5 5 5 5 0 1\n",                  // zero length
+        "line a 0 0 10 0 1 0\n",                 // direction along the line
+        "poly p 0 0 10 0 10 10\n",               // neither in nor out
+        "poly p in 0 0 10 0\n",                  // two points
+        "poly p in 0 0 10 0 10\n",               // odd coordinate count
+        "poly p in 0 0 1 0 2 0 3 0 4 0 5 0 6 0 7 0 8 0\n", // 9 points
+    };
+    for (const char *text : invalid) {
+        if (counting::parse_zones(text, zones, counting::MAX_ZONES) != -1) {
+            std::fprintf(stderr, "accepted: %s", text);
+            check::failures()++;
+        }
+    }
+
+    // More zones than fit, and a line longer than the parser's buffer
+    CHECK_EQ(counting::parse_zones("line a 0 0 10 0 0 1\nline b 0 5 10 5 0 1\n", zones, 1), -1);
+    const std::string long_line = "line a 0 0 10 0 0 1" + std::string(300, ' ') + "\n";
+    CHECK_EQ(counting::parse_zones(long_line.c_str(), zones, counting::MAX_ZONES), -1);
+}
+
+int main() {
+    test_einflug();
+    test_ausflug();
+    test_back_and_forth();
+    test_hovering_on_line();
+    test_touching_line();
+    test_bees_passing();
+    test_bees_side_by_side();
+    test_dropout_within_max_age();
+    test_dropout_beyond_max_age();
+    test_ids_not_reused();
+    test_single_detection_not_counted();
+    test_parse_zones();
+    return check::result();
+}
@@ -0,0 +1,76 @@
+// frame::crop_rgb565_to_rgb888 against the former capture path: convert the whole
+// camera frame with dl::image::RGB5652RGB888<true, false>, then copy the crop rows.
+// test_crop_esp_dl builds this file with BEESENSE_ESP_DL and takes the functor from
+// esp-dl itself; test_crop uses the copy below where esp-dl is not available.
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "frame_convert.hpp"
+#include "check.hpp"
+
+#if BEESENSE_ESP_DL
+#include "dl_image_color.hpp"
+
+static void reference_pixel(const uint8_t *src, uint8_t *dst) {
+    dl::image::RGB5652RGB888<true, false> converter;
+    converter(src, dst);
+}
+#else
+// dl::image::RGB5652RGB888<true, false>: big-endian input, R, G, B output
+static void reference_pixel(const uint8_t *src, uint8_t *dst) {
+    const uint16_t pixel = uint16_t((src[0] << 8) | src[1]);
+    dst[0] = uint8_t((pixel >> 8) & 0xF8);
+    dst[1] = uint8_t((pixel >> 3) & 0xFC);
+    dst[2] = uint8_t((pixel << 3) & 0xF8);
+}
+#endif
+
+static std::vector<uint8_t> reference_crop(const std::vector<uint8_t> &frame, int frame_w, int frame_h,
+                                           int x0, int y0, int w, int h) {
+    std::vector<uint8_t> rgb888(size_t(frame_w) * frame_h * 3);
+    for (int i = 0; i < frame_w * frame_h; ++i) {
+        reference_pixel(&frame[i * 2], &rgb888[i * 3]);
+    }
+    std::vector<uint8_t> crop(size_t(w) * h * 3);
+    for (int y = 0; y < h; ++y) {
+        memcpy(&crop[size_t(y) * w * 3], &rgb888[(size_t(y0 + y) * frame_w + x0) * 3], size_t(w) * 3);
+    }
+    return crop;
+}
+
+int main() {
+    static constexpr int FRAME_W = 320, FRAME_H = 240; // QVGA like the camera
+    std::vector<uint8_t> frame(FRAME_W * FRAME_H * 2);
+    srand(1);
+    for (uint8_t &b : frame) {
+        b = uint8_t(rand());
+    }
+
+    struct crop_t {
+        int x0, y0, w, h;
+    };
+    const crop_t crops[] = {
+        {48, 8, 224, 224},   // center crop of QVGA
+        {0, 0, 224, 224},
+        {96, 16, 224, 224},  // bottom right corner
+        {1, 1, 224, 224},    // odd origin
+        {47, 7, 224, 224},
+        {95, 15, 224, 224},
+        {3, 5, 33, 17},      // odd size
+        {319, 239, 1, 1},
+        {0, 0, FRAME_W, FRAME_H},
+    };
+    for (const crop_t &c : crops) {
+        const std::vector<uint8_t> expected = reference_crop(frame, FRAME_W, FRAME_H, c.x0, c.y0, c.w, c.h);
+        std::vector<uint8_t> out(expected.size());
+        frame::crop_rgb565_to_rgb888(frame.data(), FRAME_W, c.x0, c.y0, c.w, c.h, out.data());
+        if (out != expected) {
+            std::fprintf(stderr, "crop %d,%d %dx%d differs\n", c.x0, c.y0, c.w, c.h);
+        }
+        CHECK(out == expected);
+    }
+    return check::result();
+}
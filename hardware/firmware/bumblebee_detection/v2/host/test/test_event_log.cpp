@@ -0,0 +1,232 @@
+// eventlog::EventLog written, reopened and decoded with host/decode_events.py:
+// the CRC against zlib, append after reopen, a torn block the decoder skips and a
+// full block whose write failed (RLIMIT_FSIZE) and that the next sync writes again.
+//
+//   test_event_log PYTHON DECODE_EVENTS_PY WORK_DIR
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "event_log.hpp"
+#include "check.hpp"
+
+using eventlog::RECORDS_PER_BLOCK;
+using eventlog::BLOCK_SIZE;
+
+static constexpr uint32_t UNIX_TIME = 1700000000;
+static constexpr int FIRST_DETECTIONS = 45;  // session + 45 records: two full blocks and 6 in a third
+static constexpr int TORN_BLOCK = 1;         // detections 20..39
+static constexpr int RETRY_DETECTIONS = 23;  // one full block that fails first, 3 in the next
+// Decoded rows without the two session records, with all blocks and without the torn one
+static constexpr size_t NUM_ROWS = FIRST_DETECTIONS + RECORDS_PER_BLOCK - 1 + RETRY_DETECTIONS;
+static constexpr size_t NUM_ROWS_TORN = NUM_ROWS - RECORDS_PER_BLOCK;
+
+struct row_t {
+    std::string session, unix_time_ms, time_ms, frame_id, type, track_id, score, zone, direction, einflug, ausflug;
+};
+
+static long file_size(const std::string &path) {
+    FILE *f = std::fopen(path.c_str(), "rb");
+    if (!f) {
+        return -1;
+    }
+    std::fseek(f, 0, SEEK_END);
+    const long size = std::ftell(f);
+    std::fclose(f);
+    return size;
+}
+
+static void set_file_size_limit(rlim_t limit) {
+    rlimit rl = {};
+    getrlimit(RLIMIT_FSIZE, &rl);
+    rl.rlim_cur = limit;
+    CHECK(setrlimit(RLIMIT_FSIZE, &rl) == 0);
+}
+
+static void write_log(const std::string &path) {
+    std::remove(path.c_str());
+
+    // First session: 46 records in three blocks
+    {
+        eventlog::EventLog log(1000);
+        CHECK(log.open(path.c_str(), 1000, UNIX_TIME));
+        for (int i = 1; i <= FIRST_DETECTIONS; ++i) {
+            log.detection(1000 + i * 100, i, i % 3, 10, 20, 110, 120, 0.5f);
+        }
+        CHECK_EQ(log.stats().blocks, 2);
+        log.close();
+        CHECK_EQ(log.stats().errors, 0);
+    }
+    CHECK_EQ(file_size(path), 3 * BLOCK_SIZE);
+
+    // Second session continues after the last whole block, without wall clock
+    eventlog::EventLog log(1000);
+    CHECK(log.open(path.c_str(), 5000, 0));
+    for (int i = 0; i < RECORDS_PER_BLOCK - 1; ++i) {
+        log.crossing(5000 + i * 100, 100 + i, 7, 0, i % 2, i / 2 + 1, (i + 1) / 2);
+    }
+    CHECK_EQ(file_size(path), 4 * BLOCK_SIZE);
+
+    // The next full block lies beyond the limit, its write fails and it is kept
+    set_file_size_limit(4 * BLOCK_SIZE);
+    for (int i = 0; i < RETRY_DETECTIONS; ++i) {
+        log.detection(8000 + i * 100, 200 + i, 9, 1, 2, 3, 4, 0.75f);
+    }
+    CHECK(log.stats().errors > 0);
+    CHECK(!log.sync(11000));
+    CHECK_EQ(file_size(path), 4 * BLOCK_SIZE);
+
+    set_file_size_limit(RLIM_INFINITY);
+    CHECK(log.sync(12000));
+    CHECK_EQ(log.stats().lost, 0);
+    log.close();
+    CHECK_EQ(file_size(path), 6 * BLOCK_SIZE);
+}
+
+static void tear_block(const std::string &path, int block) {
+    FILE *f = std::fopen(path.c_str(), "r+b");
+    CHECK(f != nullptr);
+    if (!f) {
+        return;
+    }
+    std::fseek(f, block * BLOCK_SIZE + 100, SEEK_SET);
+    const int c = std::fgetc(f);
+    std::fseek(f, block * BLOCK_SIZE + 100, SEEK_SET);
+    std::fputc(c ^ 0xFF, f);
+    std::fclose(f);
+}
+
+static std::vector<std::string> split(const std::string &line) {
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (true) {
+        const size_t comma = line.find(',', start);
+        fields.push_back(line.substr(start, comma - start));
+        if (comma == std::string::npos) {
+            return fields;
+        }
+        start = comma + 1;
+    }
+}
+
+// CSV of decode_events.py, columns as in its COLUMNS
+static std::vector<row_t> decode(const std::string &python, const std::string &script, const std::string &log,
+                                 const std::string &csv, const std::string &err) {
+    const std::string cmd = "\"" + python + "\" \"" + script + "\" \"" + log + "\" -o \"" + csv + "\" 2> \"" + err + "\"";
+    CHECK_EQ(std::system(cmd.c_str()), 0);
+
+    std::vector<row_t> rows;
+    FILE *f = std::fopen(csv.c_str(), "r");
+    CHECK(f != nullptr);
+    if (!f) {
+        return rows;
+    }
+    char line[512];
+    bool header = true;
+    while (std::fgets(line, sizeof(line), f)) {
+        std::string text(line);
+        while (!text.empty() && (text.back() == '\n' || text.back() == '\r')) {
+            text.pop_back();
+        }
+        if (header) {
+            CHECK(text == "session,unix_time_ms,time_ms,frame_id,type,track_id,x1,y1,x2,y2,score,zone,direction,"
+                          "einflug,ausflug");
+            header = false;
+            continue;
+        }
+        const std::vector<std::string> c = split(text);
+        CHECK_EQ(c.size(), 15);
+        if (c.size() == 15) {
+            rows.push_back({c[0], c[1], c[2], c[3], c[4], c[5], c[10], c[11], c[12], c[13], c[14]});
+        }
+    }
+    std::fclose(f);
+    return rows;
+}
+
+static std::string read_file(const std::string &path) {
+    std::string text;
+    FILE *f = std::fopen(path.c_str(), "r");
+    if (!f) {
+        return text;
+    }
+    char buf[256];
+    size_t n;
+    while ((n = std::fread(buf, 1, sizeof(buf), f)) > 0) {
+        text.append(buf, n);
+    }
+    std::fclose(f);
+    return text;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 4) {
+        std::fprintf(stderr, "usage: %s PYTHON DECODE_EVENTS_PY WORK_DIR\n", argv[0]);
+        return 2;
+    }
+    const std::string python = argv[1], script = argv[2], dir = argv[3];
+    const std::string log = dir + "/events.bin", csv = dir + "/events.csv", err = dir + "/events.err";
+
+    // zlib.crc32 check value
+    CHECK_EQ(eventlog::crc32(reinterpret_cast<const uint8_t *>("123456789"), 9), 0xCBF43926u);
+
+    // Writes beyond RLIMIT_FSIZE fail with EFBIG instead of killing the process
+    std::signal(SIGXFSZ, SIG_IGN);
+    write_log(log);
+
+    // Untouched, every record comes back
+    std::vector<row_t> rows = decode(python, script, log, csv, err);
+    CHECK_EQ(rows.size(), NUM_ROWS);
+    CHECK(read_file(err).empty());
+
+    tear_block(log, TORN_BLOCK);
+    rows = decode(python, script, log, csv, err);
+    CHECK(read_file(err).find("1 Blöcke") != std::string::npos);
+    CHECK_EQ(rows.size(), NUM_ROWS_TORN);
+    if (rows.size() != NUM_ROWS_TORN) {
+        return check::result();
+    }
+
+    // First session: detections 1..19 and 40..45, block 1 is gone
+    size_t r = 0;
+    for (int frame = 1; frame <= FIRST_DETECTIONS; ++frame) {
+        if (frame >= TORN_BLOCK * RECORDS_PER_BLOCK && frame < (TORN_BLOCK + 1) * RECORDS_PER_BLOCK) {
+            continue;
+        }
+        const row_t &row = rows[r++];
+        CHECK(row.session == "0");
+        CHECK(row.type == "detection");
+        CHECK_EQ(std::atoi(row.frame_id.c_str()), frame);
+        CHECK_EQ(std::atoi(row.time_ms.c_str()), 1000 + frame * 100);
+        CHECK_EQ(std::atoll(row.unix_time_ms.c_str()), UNIX_TIME * 1000ll + frame * 100);
+        CHECK(row.score == "0.5");
+    }
+
+    // Second session after the reopen: the crossings, then the retried block and the rest
+    for (int i = 0; i < RECORDS_PER_BLOCK - 1; ++i) {
+        const row_t &row = rows[r++];
+        CHECK(row.session == "1");
+        CHECK(row.unix_time_ms.empty());
+        CHECK(row.type == "crossing");
+        CHECK_EQ(std::atoi(row.frame_id.c_str()), 100 + i);
+        CHECK(row.direction == (i % 2 == 0 ? "einflug" : "ausflug"));
+        CHECK_EQ(std::atoi(row.einflug.c_str()), i / 2 + 1);
+        CHECK_EQ(std::atoi(row.ausflug.c_str()), (i + 1) / 2);
+        CHECK(row.zone == "0");
+    }
+    for (int i = 0; i < RETRY_DETECTIONS; ++i) {
+        const row_t &row = rows[r++];
+        CHECK(row.session == "1");
+        CHECK(row.type == "detection");
+        CHECK_EQ(std::atoi(row.frame_id.c_str()), 200 + i);
+        CHECK(row.track_id == "9");
+        CHECK(row.score == "0.75");
+    }
+    return check::result();
+}
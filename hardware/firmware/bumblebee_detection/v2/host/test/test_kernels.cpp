@@ -0,0 +1,143 @@
+// The word kernels (CONFIG_BEESENSE_FAST_KERNELS) against the scalar reference on
+// random buffers, with odd widths and starts that are not 4-byte aligned.
+//
+// CMakeLists.txt builds this file twice: test_kernels_scalar links frame_convert.cpp
+// compiled with CONFIG_BEESENSE_FAST_KERNELS unset and writes a hash of every job's
+// output (--write FILE), test_kernels runs the same jobs on the word kernels and
+// compares its hashes with that file.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "frame_convert.hpp"
+#include "check.hpp"
+
+static constexpr int FRAME_W = 321, FRAME_H = 243;
+static constexpr int PAD = 4; // room to shift buffers off their alignment
+static constexpr int NUM_ITERATIONS = 200;
+
+// FNV-1a
+static uint64_t hash_bytes(const uint8_t *data, size_t size) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; ++i) {
+        h = (h ^ data[i]) * 0x100000001b3ull;
+    }
+    return h;
+}
+
+// Run a job into a buffer that starts `shift` bytes past a 4-byte boundary
+template <typename Job>
+static uint64_t run(size_t bytes, int shift, Job job) {
+    std::vector<uint32_t> words((bytes + PAD) / 4 + 1);
+    uint8_t *out = reinterpret_cast<uint8_t *>(words.data()) + shift;
+    job(out);
+    return hash_bytes(out, bytes);
+}
+
+struct job_t {
+    const char *name;
+    int iteration;
+    uint64_t hash;
+};
+
+static std::vector<job_t> run_all() {
+    std::vector<job_t> jobs;
+    srand(2);
+    // Word storage so that src + shift hits every alignment
+    std::vector<uint32_t> frame_words((FRAME_W * FRAME_H * 2 + PAD) / 4 + 1);
+    std::vector<uint8_t> random(frame_words.size() * 4);
+    for (uint8_t &b : random) {
+        b = uint8_t(rand());
+    }
+    memcpy(frame_words.data(), random.data(), random.size());
+
+    for (int iter = 0; iter < NUM_ITERATIONS; ++iter) {
+        const int src_shift = iter % 4; // every combination of alignments
+        const int dst_shift = iter / 4 % 4;
+        const uint8_t *src = reinterpret_cast<const uint8_t *>(frame_words.data()) + src_shift;
+        const int src_width = FRAME_W - rand() % 8; // odd and even strides
+        const int w = 1 + rand() % (src_width - 1);
+        const int h = 1 + rand() % (FRAME_H - 1);
+        const int x0 = rand() % (src_width - w + 1);
+        const int y0 = rand() % (FRAME_H - h + 1);
+        const int dst_w = 1 + rand() % 240;
+        const int dst_h = 1 + rand() % 240;
+        const int num_pixels = 1 + rand() % (FRAME_W * FRAME_H * 2 / 3 - 1);
+        // Exact 2:1 downscale of (most of) the same window
+        const int half_w = (w + 1) / 2, half_h = (h + 1) / 2;
+        const int x2 = std::min(x0, src_width - 2 * half_w), y2 = std::min(y0, FRAME_H - 2 * half_h);
+
+        jobs.push_back({"crop_rgb565_to_rgb888", iter, run(size_t(w) * h * 3, dst_shift, [&](uint8_t *d) {
+            frame::crop_rgb565_to_rgb888(src, src_width, x0, y0, w, h, d);
+        })});
+        jobs.push_back({"resize_rgb565", iter, run(size_t(dst_w) * dst_h * 2, dst_shift, [&](uint8_t *d) {
+            frame::resize_rgb565(src, src_width, x0, y0, w, h, d, dst_w, dst_h);
+        })});
+        jobs.push_back({"resize_rgb565_to_rgb888", iter, run(size_t(dst_w) * dst_h * 3, dst_shift, [&](uint8_t *d) {
+            frame::resize_rgb565_to_rgb888(src, src_width, x0, y0, w, h, d, dst_w, dst_h);
+        })});
+        jobs.push_back({"resize_rgb565 2:1", iter, run(size_t(half_w) * half_h * 2, dst_shift, [&](uint8_t *d) {
+            frame::resize_rgb565(src, src_width, x2, y2, 2 * half_w, 2 * half_h, d, half_w, half_h);
+        })});
+        jobs.push_back({"resize_rgb565_to_rgb888 2:1", iter, run(size_t(half_w) * half_h * 3, dst_shift, [&](uint8_t *d) {
+            frame::resize_rgb565_to_rgb888(src, src_width, x2, y2, 2 * half_w, 2 * half_h, d, half_w, half_h);
+        })});
+        jobs.push_back({"rgb888_to_rgb565", iter, run(size_t(num_pixels) * 2, dst_shift, [&](uint8_t *d) {
+            frame::rgb888_to_rgb565(src, num_pixels, d);
+        })});
+    }
+    return jobs;
+}
+
+static int write_reference(const char *path) {
+    FILE *f = std::fopen(path, "w");
+    if (!f) {
+        std::perror(path);
+        return 1;
+    }
+    for (const job_t &job : run_all()) {
+        std::fprintf(f, "%016llx\n", (unsigned long long)job.hash);
+    }
+    return std::fclose(f) == 0 ? 0 : 1;
+}
+
+static int compare_with(const char *path) {
+#if !CONFIG_BEESENSE_FAST_KERNELS
+    std::fprintf(stderr, "test_kernels compares the word kernels, enable CONFIG_BEESENSE_FAST_KERNELS\n");
+    return 1;
+#endif
+    FILE *f = std::fopen(path, "r");
+    if (!f) {
+        std::perror(path);
+        return 1;
+    }
+    for (const job_t &job : run_all()) {
+        unsigned long long expected = 0;
+        if (std::fscanf(f, "%llx", &expected) != 1) {
+            std::fprintf(stderr, "%s: fewer jobs than this build runs\n", path);
+            check::failures()++;
+            break;
+        }
+        if (job.hash != expected) {
+            std::fprintf(stderr, "%s differs from the scalar reference in iteration %d\n", job.name, job.iteration);
+            check::failures()++;
+        }
+    }
+    std::fclose(f);
+    return check::result();
+}
+
+int main(int argc, char **argv) {
+    if (argc == 3 && strcmp(argv[1], "--write") == 0) {
+        return write_reference(argv[2]);
+    }
+    if (argc == 2) {
+        return compare_with(argv[1]);
+    }
+    std::fprintf(stderr, "usage: %s --write FILE | FILE\n", argv[0]);
+    return 2;
+}
@@ -0,0 +1,61 @@
+// motion::MotionGate on flat gray frames: cell means for even and odd block sizes,
+// the change threshold and the background reset.
+
+#include <cstdint>
+#include <vector>
+
+#include "motion_gate.hpp"
+#include "check.hpp"
+
+static constexpr int SIZE = 224;
+
+// RGB888 frame of one gray level, whose luma is that level
+static std::vector<uint8_t> gray(uint8_t level) {
+    return std::vector<uint8_t>(SIZE * SIZE * 3, level);
+}
+
+static motion::config_t config(int block_size) {
+    return {
+        .block_size = block_size,
+        .cell_threshold = 25,
+        .min_changed_cells = 1,
+        .background_shift = 3,
+        .force_interval = 0,
+    };
+}
+
+static void test_threshold(int block_size) {
+    motion::MotionGate gate(config(block_size));
+    const int cells = (SIZE / block_size) * (SIZE / block_size);
+
+    // The first frame only sets the background
+    CHECK(gate.update(gray(100).data(), SIZE, SIZE, false));
+    CHECK(!gate.update(gray(100).data(), SIZE, SIZE, false));
+    CHECK_EQ(gate.changed_cells(), 0);
+
+    // 20 levels brighter stays below the threshold of 25 in every cell
+    CHECK(!gate.update(gray(120).data(), SIZE, SIZE, false));
+    CHECK_EQ(gate.changed_cells(), 0);
+
+    // 60 levels darker is a change everywhere
+    CHECK(gate.update(gray(60).data(), SIZE, SIZE, false));
+    CHECK_EQ(gate.changed_cells(), cells);
+}
+
+static void test_reset() {
+    motion::MotionGate gate(config(8));
+    gate.update(gray(100).data(), SIZE, SIZE, false);
+    gate.reset();
+    // After a reset the next frame becomes the background and nothing is compared
+    CHECK(gate.update(gray(200).data(), SIZE, SIZE, false));
+    CHECK(!gate.update(gray(200).data(), SIZE, SIZE, false));
+    CHECK_EQ(gate.stats().frames, 3);
+}
+
+int main() {
+    for (int block_size = 4; block_size <= 32; ++block_size) {
+        test_threshold(block_size);
+    }
+    test_reset();
+    return check::result();
+}
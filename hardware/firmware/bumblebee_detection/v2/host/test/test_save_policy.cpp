@@ -0,0 +1,139 @@
+// save_policy::SavePolicy on scripted frame sequences: pre-roll flush, post-roll
+// countdown, re-trigger during the post-roll, score threshold, keyframe interval
+// and SAVE_ALL.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "save_policy.hpp"
+#include "check.hpp"
+
+using save_policy::SAVE_ALL;
+using save_policy::SAVE_CROSSINGS;
+using save_policy::SAVE_DETECTIONS;
+
+static const save_policy::config_t CFG = {
+    .modes = SAVE_DETECTIONS | SAVE_CROSSINGS,
+    .min_score = 0.5f,
+    .pre_roll = 2,
+    .post_roll = 2,
+    .keyframe_interval = 0,
+};
+
+// One character per frame:
+//   .  nothing     d  detection with score 0.8    w  detection with score 0.3
+//   m  detection exactly at min_score             x  counted crossing, no detection
+// Decisions, one character per frame:
+//   E  event, flush the pre-roll    e  event without pre-roll
+//   s  saved without event          -  not saved
+static std::string run(save_policy::SavePolicy &policy, const char *script) {
+    std::string out;
+    for (const char *c = script; *c; ++c) {
+        save_policy::frame_info_t info = {};
+        switch (*c) {
+        case 'd': info = {1, 0.8f, 0}; break;
+        case 'w': info = {1, 0.3f, 0}; break;
+        case 'm': info = {1, policy.config().min_score, 0}; break;
+        case 'x': info = {0, 0.0f, 1}; break;
+        default: break;
+        }
+        const save_policy::decision_t d = policy.evaluate(info);
+        CHECK(d.save || (!d.event && !d.flush_pre_roll));
+        out += d.event ? (d.flush_pre_roll ? 'E' : 'e') : d.save ? 's' : '-';
+    }
+    return out;
+}
+
+static void expect(const save_policy::config_t &cfg, const char *script, const char *expected) {
+    save_policy::SavePolicy policy(cfg);
+    const std::string got = run(policy, script);
+    if (got != expected) {
+        std::fprintf(stderr, "script %s: expected %s, got %s\n", script, expected, got.c_str());
+    }
+    CHECK(got == expected);
+}
+
+static void test_pre_and_post_roll() {
+    save_policy::SavePolicy policy(CFG);
+    // The event flushes the pre-roll, the two frames after it are saved, then nothing
+    CHECK(run(policy, "...d....") == "---Ess--");
+    CHECK_EQ(policy.stats().frames, 8);
+    CHECK_EQ(policy.stats().events, 1);
+    CHECK_EQ(policy.stats().saved, 3);
+    CHECK_EQ(policy.stats().keyframes, 0);
+
+    // Without pre-roll there is nothing to flush
+    save_policy::config_t cfg = CFG;
+    cfg.pre_roll = 0;
+    expect(cfg, "..d...", "--ess-");
+
+    // Without post-roll only the event frame itself
+    cfg = CFG;
+    cfg.post_roll = 0;
+    expect(cfg, ".d..", "-E--");
+}
+
+static void test_retrigger() {
+    save_policy::config_t cfg = CFG;
+    cfg.post_roll = 3;
+    // A new event during the post-roll starts the countdown again
+    expect(cfg, "d.d.....", "EsEsss--");
+    // Back-to-back events are each an event of their own
+    expect(cfg, "ddd....", "EEEsss-");
+    // Crossings trigger like detections
+    expect(cfg, "x.x.....", "EsEsss--");
+}
+
+static void test_score_and_modes() {
+    // Below min_score no event, at min_score an event (>=)
+    expect(CFG, "w.m..", "--Ess");
+
+    // Only crossings: detections alone are not saved
+    save_policy::config_t cfg = CFG;
+    cfg.modes = SAVE_CROSSINGS;
+    expect(cfg, "d.x...", "--Ess-");
+
+    // Only detections: crossings alone are not saved
+    cfg.modes = SAVE_DETECTIONS;
+    expect(cfg, "x.d...", "--Ess-");
+}
+
+static void test_keyframes() {
+    save_policy::config_t cfg = CFG;
+    cfg.keyframe_interval = 4;
+    save_policy::SavePolicy policy(cfg);
+    // Every fourth frame without an event
+    CHECK(run(policy, ".........") == "---s---s-");
+    CHECK_EQ(policy.stats().keyframes, 2);
+    CHECK_EQ(policy.stats().saved, 2);
+
+    // Every saved frame restarts the interval, event and post-roll frames included
+    cfg.post_roll = 1;
+    expect(cfg, "..d.........", "--Es---s---s");
+}
+
+static void test_save_all() {
+    save_policy::config_t cfg = CFG;
+    cfg.modes = SAVE_ALL | SAVE_DETECTIONS;
+    cfg.keyframe_interval = 2;
+    save_policy::SavePolicy policy(cfg);
+    // Every frame is saved, events are still reported, no keyframes are needed
+    CHECK(run(policy, "..d...") == "ssEsss");
+    CHECK_EQ(policy.stats().saved, 6);
+    CHECK_EQ(policy.stats().events, 1);
+    CHECK_EQ(policy.stats().keyframes, 0);
+
+    // SAVE_ALL alone never reports an event
+    cfg.modes = SAVE_ALL;
+    expect(cfg, "dxd", "sss");
+}
+
+int main() {
+    test_pre_and_post_roll();
+    test_retrigger();
+    test_score_and_modes();
+    test_keyframes();
+    test_save_all();
+    return check::result();
+}
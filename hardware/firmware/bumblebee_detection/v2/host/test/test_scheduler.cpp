@@ -0,0 +1,149 @@
+// scheduler::Scheduler on a simulated clock: active/quiet/night transitions, the
+// night window around midnight, power-down decisions and the duty cycle.
+
+#include <cmath>
+#include <cstdint>
+
+#include "frame_scheduler.hpp"
+#include "check.hpp"
+
+static const scheduler::config_t CFG = {
+    .active_interval_ms = 0,
+    .quiet_after_ms = 30000,
+    .quiet_interval_ms = 1000,
+    .night_start_hour = 21,
+    .night_end_hour = 5,
+    .night_interval_ms = 10000,
+    .power_down_min_ms = 500,
+};
+
+static constexpr uint32_t FRAME_MS = 200; // time a frame keeps the device awake
+
+// Mode the scheduler picks for an idle device at this hour
+static scheduler::mode_t idle_mode(const scheduler::config_t &cfg, int hour) {
+    scheduler::Scheduler s(cfg);
+    return s.next(cfg.quiet_after_ms, 0, hour).mode;
+}
+
+static void test_active_to_quiet_and_back() {
+    scheduler::Scheduler s(CFG);
+    uint32_t now = 0;
+    const uint32_t last_activity = 0;
+
+    // Active right after the activity, as fast as the pipeline runs
+    scheduler::plan_t plan = s.next(now, last_activity, 12);
+    CHECK_EQ(plan.mode, scheduler::MODE_ACTIVE);
+    CHECK_EQ(plan.delay_ms, 0);
+    CHECK(!plan.power_down);
+
+    // Still active 1 ms before quiet_after
+    plan = s.next(CFG.quiet_after_ms - 1, last_activity, 12);
+    CHECK_EQ(plan.mode, scheduler::MODE_ACTIVE);
+
+    // Quiet from quiet_after on, with the camera off during the wait
+    now = CFG.quiet_after_ms;
+    plan = s.next(now, last_activity, 12);
+    CHECK_EQ(plan.mode, scheduler::MODE_QUIET);
+    CHECK_EQ(plan.delay_ms, CFG.quiet_interval_ms);
+    CHECK(plan.power_down);
+    CHECK_EQ(s.stats().switches, 1);
+
+    // Activity switches back at once
+    now += plan.delay_ms + FRAME_MS;
+    plan = s.next(now, now, 12);
+    CHECK_EQ(plan.mode, scheduler::MODE_ACTIVE);
+    CHECK_EQ(s.stats().switches, 2);
+    CHECK_EQ(s.stats().power_downs, 1);
+}
+
+static void test_night() {
+    scheduler::Scheduler s(CFG);
+    // Idle at 22 h is night, with the night interval
+    scheduler::plan_t plan = s.next(CFG.quiet_after_ms, 0, 22);
+    CHECK_EQ(plan.mode, scheduler::MODE_NIGHT);
+    CHECK_EQ(plan.delay_ms, CFG.night_interval_ms);
+    CHECK(plan.power_down);
+
+    // Activity wins over night
+    plan = s.next(CFG.quiet_after_ms + 20000, CFG.quiet_after_ms + 20000, 22);
+    CHECK_EQ(plan.mode, scheduler::MODE_ACTIVE);
+
+    // Without a set clock there is no night
+    CHECK_EQ(idle_mode(CFG, -1), scheduler::MODE_QUIET);
+}
+
+static void test_night_window() {
+    // 21 -> 5 wraps around midnight
+    const int night[] = {21, 22, 23, 0, 1, 4};
+    const int day[] = {5, 6, 12, 20};
+    for (int hour : night) {
+        CHECK_EQ(idle_mode(CFG, hour), scheduler::MODE_NIGHT);
+    }
+    for (int hour : day) {
+        CHECK_EQ(idle_mode(CFG, hour), scheduler::MODE_QUIET);
+    }
+
+    // A window within one day
+    scheduler::config_t cfg = CFG;
+    cfg.night_start_hour = 1;
+    cfg.night_end_hour = 4;
+    CHECK_EQ(idle_mode(cfg, 0), scheduler::MODE_QUIET);
+    CHECK_EQ(idle_mode(cfg, 1), scheduler::MODE_NIGHT);
+    CHECK_EQ(idle_mode(cfg, 3), scheduler::MODE_NIGHT);
+    CHECK_EQ(idle_mode(cfg, 4), scheduler::MODE_QUIET);
+    CHECK_EQ(idle_mode(cfg, 23), scheduler::MODE_QUIET);
+
+    // Equal start and end disable night mode
+    cfg.night_start_hour = cfg.night_end_hour = 3;
+    for (int hour = 0; hour < 24; ++hour) {
+        CHECK_EQ(idle_mode(cfg, hour), scheduler::MODE_QUIET);
+    }
+}
+
+static void test_power_down_threshold() {
+    scheduler::config_t cfg = CFG;
+    cfg.quiet_interval_ms = cfg.power_down_min_ms - 1;
+    scheduler::Scheduler s(cfg);
+    const scheduler::plan_t plan = s.next(cfg.quiet_after_ms, 0, 12);
+    CHECK_EQ(plan.mode, scheduler::MODE_QUIET);
+    CHECK(!plan.power_down);
+}
+
+static void test_duty_cycle() {
+    scheduler::Scheduler s(CFG);
+    CHECK(s.duty_cycle(scheduler::MODE_QUIET) == 1.0f);
+
+    // Idle for an hour of simulated time: active until quiet_after, then 200 ms awake per second
+    uint32_t now = 0;
+    while (now < 3600 * 1000) {
+        const scheduler::plan_t plan = s.next(now, 0, 12);
+        now += FRAME_MS + plan.delay_ms;
+    }
+    const scheduler::stats_t &st = s.stats();
+    CHECK(s.duty_cycle(scheduler::MODE_ACTIVE) == 1.0f);
+    const float quiet = s.duty_cycle(scheduler::MODE_QUIET);
+    CHECK(std::fabs(quiet - float(FRAME_MS) / float(FRAME_MS + CFG.quiet_interval_ms)) < 1e-3f);
+    CHECK_EQ(st.frames[scheduler::MODE_ACTIVE], CFG.quiet_after_ms / FRAME_MS);
+    CHECK(st.mode_ms[scheduler::MODE_ACTIVE] + st.mode_ms[scheduler::MODE_QUIET] <= now);
+    CHECK_EQ(st.mode_ms[scheduler::MODE_NIGHT], 0);
+    CHECK_EQ(st.switches, 1);
+}
+
+static void test_clock_wrap() {
+    // The millisecond clock wraps after 49 days, intervals must survive that
+    scheduler::Scheduler s(CFG);
+    const uint32_t activity = 0xFFFFFFFFu - 10000;
+    CHECK_EQ(s.next(activity + 20000, activity, 12).mode, scheduler::MODE_ACTIVE);
+    CHECK_EQ(s.next(activity + CFG.quiet_after_ms, activity, 12).mode, scheduler::MODE_QUIET);
+    CHECK_EQ(s.stats().mode_ms[scheduler::MODE_ACTIVE], CFG.quiet_after_ms - 20000);
+}
+
+int main() {
+    test_active_to_quiet_and_back();
+    test_night();
+    test_night_window();
+    test_power_down_threshold();
+    test_duty_cycle();
+    test_clock_wrap();
+    return check::result();
+}
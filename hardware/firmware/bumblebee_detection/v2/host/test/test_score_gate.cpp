@@ -0,0 +1,132 @@
+// bumblebee_detect::quantized_logit and any_above, the gate in front of the ESPDet
+// postprocessor: for every int8 and int16 score and the exponents the models use, the
+// gate keeps exactly the scores whose sigmoid lies above the threshold, also where the
+// logit falls on or next to the quantization grid. Plus the class mask and the anchor
+// stride of any_above.
+
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+#include "score_gate.hpp"
+#include "check.hpp"
+
+using bumblebee_detect::any_above;
+using bumblebee_detect::quantized_logit;
+
+static const float THRESHOLDS[] = {0.05f, 0.25f, 0.3f, 0.5f, 0.6f, 0.75f, 0.9f, 0.99f, 1e-6f, 1.0f - 1e-6f};
+
+static double sigmoid(double x) {
+    return 1.0 / (1.0 + std::exp(-x));
+}
+
+// The threshold exactly as the gate sees it, as a double
+static bool above(int32_t x, int exponent, float score_thr) {
+    return sigmoid(std::ldexp(double(x), exponent)) > double(score_thr);
+}
+
+// x > q for every score of type T, against the sigmoid of the dequantized score
+template <typename T>
+static void check_exact(int exponent, float score_thr) {
+    const int32_t q = quantized_logit(score_thr, exponent);
+    int mismatches = 0;
+    for (int32_t x = INT16_MIN; x <= INT16_MAX; ++x) {
+        if (x < std::numeric_limits<T>::min() || x > std::numeric_limits<T>::max()) {
+            continue;
+        }
+        const T value = T(x);
+        const bool gate = any_above(&value, 1, 1, q, 1u);
+        if (gate != above(x, exponent, score_thr)) {
+            if (mismatches++ == 0) {
+                std::fprintf(stderr, "%d bit, exponent %d, threshold %.9g: score %d gate %d, sigmoid %.17g\n",
+                             int(sizeof(T) * 8), exponent, score_thr, x, gate,
+                             sigmoid(std::ldexp(double(x), exponent)));
+            }
+        }
+    }
+    CHECK_EQ(mismatches, 0);
+}
+
+// Thresholds whose logit is a multiple of 2^exponent: the score on the grid point has a
+// sigmoid of exactly the threshold (up to float rounding) and must not pass, the next one must
+template <typename T>
+static void check_on_grid(int exponent) {
+    const T max = std::numeric_limits<T>::max();
+    for (int32_t x : {int32_t(-max / 2), int32_t(-3), int32_t(0), int32_t(1), int32_t(max / 3)}) {
+        const float score_thr = float(sigmoid(std::ldexp(double(x), exponent)));
+        if (score_thr <= 0.0f || score_thr >= 1.0f) {
+            continue;
+        }
+        check_exact<T>(exponent, score_thr);
+    }
+}
+
+static void test_int8() {
+    for (int exponent = -7; exponent <= -2; ++exponent) {
+        for (float score_thr : THRESHOLDS) {
+            check_exact<int8_t>(exponent, score_thr);
+        }
+        check_on_grid<int8_t>(exponent);
+    }
+    // 0.5 is logit 0: score 0 stays out, score 1 passes
+    CHECK_EQ(quantized_logit(0.5f, -7), 0);
+}
+
+static void test_int16() {
+    for (int exponent = -14; exponent <= -8; ++exponent) {
+        for (float score_thr : THRESHOLDS) {
+            check_exact<int16_t>(exponent, score_thr);
+        }
+        check_on_grid<int16_t>(exponent);
+    }
+}
+
+static void test_limits() {
+    // Threshold 0 keeps every score, 1 none, also the extremes of the type
+    const int16_t lowest = INT16_MIN, highest = INT16_MAX;
+    CHECK(any_above(&lowest, 1, 1, quantized_logit(0.0f, -10), 1u));
+    CHECK(!any_above(&highest, 1, 1, quantized_logit(1.0f, -10), 1u));
+    // A logit beyond the type's range: nothing passes, nothing overflows
+    const int8_t max8 = INT8_MAX;
+    CHECK(quantized_logit(0.999f, -7) > INT8_MAX);
+    CHECK(!any_above(&max8, 1, 1, quantized_logit(0.999f, -7), 1u));
+    CHECK(quantized_logit(0.001f, -7) < INT8_MIN);
+    const int8_t min8 = INT8_MIN;
+    CHECK(any_above(&min8, 1, 1, quantized_logit(0.001f, -7), 1u));
+}
+
+static void test_mask_and_stride() {
+    // 5 anchors of 3 classes, one score above the threshold in anchor 3, class 1
+    const int channels = 3, anchors = 5;
+    std::vector<int8_t> scores(channels * anchors, -50);
+    scores[3 * channels + 1] = 11;
+    CHECK(any_above(scores.data(), int(scores.size()), channels, 10, 0x7u));
+    CHECK(any_above(scores.data(), int(scores.size()), channels, 10, 0x2u));
+    CHECK(!any_above(scores.data(), int(scores.size()), channels, 10, 0x5u));
+    // Exactly on the threshold is not above it
+    CHECK(!any_above(scores.data(), int(scores.size()), channels, 11, 0x7u));
+    // The last element of the last anchor is scanned
+    scores[3 * channels + 1] = -50;
+    scores[anchors * channels - 1] = 11;
+    CHECK(any_above(scores.data(), int(scores.size()), channels, 10, 0x4u));
+
+    // More than 32 channels: only the first 32 are classes the mask can select
+    const int wide = 40;
+    std::vector<int16_t> wide_scores(wide * 2, -1000);
+    wide_scores[wide + 35] = 1000;
+    CHECK(!any_above(wide_scores.data(), int(wide_scores.size()), wide, 0, 0xFFFFFFFFu));
+    wide_scores[wide + 31] = 1000;
+    CHECK(any_above(wide_scores.data(), int(wide_scores.size()), wide, 0, 0x80000000u));
+    CHECK(!any_above(wide_scores.data(), int(wide_scores.size()), wide, 0, 0x7FFFFFFFu));
+}
+
+int main() {
+    test_int8();
+    test_int16();
+    test_limits();
+    test_mask_and_stride();
+    return check::result();
+}
@@ -0,0 +1,124 @@
+// settings::parse and settings::load: valid keys, values out of range, unknown keys,
+// malformed and overlong lines and paths, and a missing file keeping the defaults.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "settings.hpp"
+#include "check.hpp"
+
+static bool same(const settings::settings_t &a, const settings::settings_t &b) {
+    return a.score_thr == b.score_thr && a.class_mask == b.class_mask && a.model_nms_thr == b.model_nms_thr &&
+           a.escalate_score == b.escalate_score && a.count_line_y == b.count_line_y &&
+           strcmp(a.zones_path, b.zones_path) == 0 && a.active_interval_ms == b.active_interval_ms &&
+           a.quiet_after_s == b.quiet_after_s && a.quiet_interval_ms == b.quiet_interval_ms &&
+           a.night_start_hour == b.night_start_hour && a.night_end_hour == b.night_end_hour &&
+           a.night_interval_ms == b.night_interval_ms && a.power_down_min_ms == b.power_down_min_ms &&
+           a.jpeg_quality == b.jpeg_quality && a.save_min_score == b.save_min_score &&
+           strcmp(a.image_dir, b.image_dir) == 0 && strcmp(a.event_log_path, b.event_log_path) == 0;
+}
+
+static void test_valid() {
+    settings::settings_t s = settings::defaults();
+    const char *text =
+        "# node at the north hive\n"
+        "score_thr = 0.5\n"
+        "  count_line_y=140   # lower line\n"
+        "\n"
+        "class_mask = 3\r\n"
+        "night_start_hour = 0\n"
+        "night_end_hour = 23\n"
+        "jpeg_quality = 100\n"
+        "image_dir = /sdcard/nord";
+    CHECK_EQ(settings::parse(text, s), 0);
+    CHECK(s.score_thr == 0.5f);
+    CHECK_EQ(s.count_line_y, 140);
+    CHECK_EQ(s.class_mask, 3);
+    CHECK_EQ(s.night_start_hour, 0);
+    CHECK_EQ(s.night_end_hour, 23);
+    CHECK_EQ(s.jpeg_quality, 100);
+    CHECK(strcmp(s.image_dir, "/sdcard/nord") == 0);
+}
+
+static void test_rejected() {
+    const settings::settings_t def = settings::defaults();
+    const char *rejected[] = {
+        "score_thr = 1.5\n",       // above the range
+        "score_thr = -0.1\n",      // below the range
+        "jpeg_quality = 0\n",
+        "night_end_hour = 24\n",
+        "class_mask = 0\n",
+        "quiet_after_s = 0\n",
+        "count_line_y = 12a\n",    // trailing characters
+        "count_line_y =\n",        // no value
+        "threshold = 0.5\n",       // unknown key
+        "Score_thr = 0.5\n",       // keys are case sensitive
+        "score_thr 0.5\n",         // no '='
+        "image_dir = sdcard/x\n",  // relative path
+    };
+    for (const char *text : rejected) {
+        settings::settings_t s = def;
+        if (settings::parse(text, s) != 1 || !same(s, def)) {
+            std::fprintf(stderr, "not rejected: %s", text);
+            check::failures()++;
+        }
+    }
+
+    // A path of PATH_LEN - 1 characters fits, one more does not
+    settings::settings_t s = def;
+    const std::string fits = "/" + std::string(settings::PATH_LEN - 2, 'a');
+    CHECK_EQ(settings::parse(("event_log_path = " + fits).c_str(), s), 0);
+    CHECK(fits == s.event_log_path);
+    s = def;
+    CHECK_EQ(settings::parse(("event_log_path = " + fits + "a").c_str(), s), 1);
+    CHECK(same(s, def));
+
+    // A line longer than the parser's buffer is rejected as a whole, the next one still counts
+    s = def;
+    const std::string text = "zones_path = /" + std::string(200, 'z') + "\njpeg_quality = 50\n";
+    CHECK_EQ(settings::parse(text.c_str(), s), 1);
+    CHECK(strcmp(s.zones_path, def.zones_path) == 0);
+    CHECK_EQ(s.jpeg_quality, 50);
+
+    // Good and bad lines mixed: only the bad ones are counted and skipped
+    s = def;
+    CHECK_EQ(settings::parse("score_thr = 0.6\nscore_thr = 2\nfoo = 1\njpeg_quality = 70\n", s), 2);
+    CHECK(s.score_thr == 0.6f);
+    CHECK_EQ(s.jpeg_quality, 70);
+}
+
+static void test_load() {
+    const settings::settings_t def = settings::defaults();
+
+    // Missing file: -1 and the defaults stay
+    settings::settings_t s = def;
+    CHECK_EQ(settings::load("/nonexistent/beesense.cfg", s), -1);
+    CHECK(same(s, def));
+
+    // The same rules as parse(), read line by line
+    const char *path = "test_settings.cfg";
+    FILE *f = std::fopen(path, "w");
+    CHECK(f != nullptr);
+    if (!f) {
+        return;
+    }
+    std::fprintf(f, "score_thr = 0.45\n");
+    std::fprintf(f, "image_dir = /%s\n", std::string(300, 'x').c_str()); // longer than the read buffer
+    std::fprintf(f, "night_interval_ms = 4000000\n");                   // out of range
+    std::fprintf(f, "quiet_interval_ms = 2000");                         // no final newline
+    std::fclose(f);
+    CHECK_EQ(settings::load(path, s), 2);
+    CHECK(s.score_thr == 0.45f);
+    CHECK(strcmp(s.image_dir, def.image_dir) == 0);
+    CHECK_EQ(s.night_interval_ms, def.night_interval_ms);
+    CHECK_EQ(s.quiet_interval_ms, 2000);
+    std::remove(path);
+}
+
+int main() {
+    test_valid();
+    test_rejected();
+    test_load();
+    return check::result();
+}
@@ -4,135 +4,493 @@
 #define MODEL_IMG_SIZE 224
 #include <stdio.h>
 #include <algorithm>
-#include "bumblebee_detect.hpp"
-#include "esp_camera.h"
+#include <cmath>
+#include "detector.hpp"
+#include "camera.hpp"
 #include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
 #include "sd_card.hpp"
+#include "frame_convert.hpp"
+#include "pipeline.hpp"
+#include "sd_writer.hpp"
+#include "save_policy.hpp"
+#include "tracker.hpp"
+#include "zone_counter.hpp"
+#include "settings.hpp"
+#include "event_log.hpp"
+#include "frame_scheduler.hpp"
+#include "motion_gate.hpp"
+#include "profiler.hpp"
 #include <esp_system.h>
+#include "esp_pm.h"
 #include <string.h>
+#include <time.h>
 #include <vector>
+#include <atomic>
 #include "bsp/esp-bsp.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "include/camera_pins.h"
 #include "dl_image_draw.hpp"
 #include "dl_image_color.hpp"
 
-extern const uint8_t bumblebee_jpg_start[] asm("_binary_bumblebee_jpg_start");
-extern const uint8_t bumblebee_jpg_end[] asm("_binary_bumblebee_jpg_end");
 const char *TAG = "bumblebee_detect";
 
-// Camera Module pin mapping
-static camera_config_t camera_config = {
-    .pin_pwdn = PWDN_GPIO_NUM,
-    .pin_reset = RESET_GPIO_NUM,
-    .pin_xclk = XCLK_GPIO_NUM,
-    .pin_sscb_sda = SIOD_GPIO_NUM,
-    .pin_sscb_scl = SIOC_GPIO_NUM,
-
-    .pin_d7 = Y9_GPIO_NUM,
-    .pin_d6 = Y8_GPIO_NUM,
-    .pin_d5 = Y7_GPIO_NUM,
-    .pin_d4 = Y6_GPIO_NUM,
-    .pin_d3 = Y5_GPIO_NUM,
-    .pin_d2 = Y4_GPIO_NUM,
-    .pin_d1 = Y3_GPIO_NUM,
-    .pin_d0 = Y2_GPIO_NUM,
-
-    .pin_vsync = VSYNC_GPIO_NUM,
-    .pin_href = HREF_GPIO_NUM,
-    .pin_pclk = PCLK_GPIO_NUM,
-
-    .xclk_freq_hz = 20000000, // XCLK 20MHz or 10MHz for OV2640 double FPS (Experimental)
-    .ledc_timer = LEDC_TIMER_0,
-    .ledc_channel = LEDC_CHANNEL_0,
-
-    .pixel_format = PIXFORMAT_RGB565, // PIXFORMAT_RGB565 , PIXFORMAT_JPEG
-    .frame_size = FRAMESIZE_QVGA, // [<<320x240>> (QVGA, 4:3); FRAMESIZE_320X320, 240x176 (HQVGA, 15:11); 400x296 (CIF,
-                                  // 50:37)],FRAMESIZE_QVGA,FRAMESIZE_VGA
-
-    .jpeg_quality = 8, // 0-63 lower number means higher quality.  Reduce quality if stack overflow in cam_task
-    .fb_count = 2,     // if more than one, i2s runs in continuous mode. Use only with JPEG
-    .fb_location = CAMERA_FB_IN_PSRAM,
-    .grab_mode = CAMERA_GRAB_WHEN_EMPTY,
-    .sccb_i2c_port = 0 // optional
-};
-
-static esp_err_t init_camera(void)
-{
-    // Initialize the camera
-    esp_err_t err = esp_camera_init(&camera_config);
-    if (err != ESP_OK) {
-        ESP_LOGE("CAM", "Camera Init Failed");
+// Auf dem ESP32-S3 liest der ImagePreprocessor Big-Endian RGB565 direkt (DL_IMAGE_CAP_RGB565_BIG_ENDIAN),
+// dort bekommt das Modell den RGB565-Ausschnitt ohne Umweg über RGB888.
+#if CONFIG_IDF_TARGET_ESP32S3
+#define MODEL_INPUT_RGB565 1
+#else
+#define MODEL_INPUT_RGB565 0
+#endif
+
+// Laufzeit-Einstellungen: Defaults aus menuconfig, beim Start von der SD-Karte überschrieben
+// (menuconfig: BeeSense -> Settings file). Danach nur noch gelesen, auch von den Pipeline-Tasks.
+static settings::settings_t g_settings = settings::defaults();
+
+// Ausschnitt des Kamerabildes, aus dem das Modell-Bild entsteht (menuconfig: BeeSense -> Region of interest).
+// Folgt das ROI den Tracks, verschiebt der Inferenz-Task die Position, die Größe bleibt fest.
+static const frame::rect_t roi_home = {CONFIG_BEESENSE_ROI_X, CONFIG_BEESENSE_ROI_Y,
+                                       CONFIG_BEESENSE_ROI_WIDTH, CONFIG_BEESENSE_ROI_HEIGHT};
+static std::atomic<int> roi_x{roi_home.x};
+static std::atomic<int> roi_y{roi_home.y};
+
+// ROI-Ausschnitt des Framebuffers in den Puffer von img bringen, je nach img.pix_type als
+// RGB565-Kopie oder konvertiert nach RGB888. Ist das ROI größer oder kleiner als img,
+// wird es skaliert (nearest neighbour).
+static void roi_to_img(const camera_fb_t *pic, const frame::rect_t &local, dl::image::img_t &img) {
+    uint8_t *dst = static_cast<uint8_t *>(img.data);
+    const bool rgb565 = img.pix_type == dl::image::DL_IMAGE_PIX_TYPE_RGB565;
+    if (local.w == img.width && local.h == img.height) {
+        if (rgb565) {
+            frame::crop_rgb565(pic->buf, pic->width, local.x, local.y, local.w, local.h, dst);
+        } else {
+            frame::crop_rgb565_to_rgb888(pic->buf, pic->width, local.x, local.y, local.w, local.h, dst);
+        }
+    } else if (rgb565) {
+        frame::resize_rgb565(pic->buf, pic->width, local.x, local.y, local.w, local.h,
+                             dst, img.width, img.height);
+    } else {
+        frame::resize_rgb565_to_rgb888(pic->buf, pic->width, local.x, local.y, local.w, local.h,
+                                       dst, img.width, img.height);
     }
-    return err;
 }
 
-// Hilfsfunktion: Bild aufnehmen, croppen und in RGB888 konvertieren
-static bool capture_and_convert_image(dl::image::img_t &cropped_img) {
-    camera_fb_t *pic = esp_camera_fb_get();
+// Hilfsfunktion: Bild aufnehmen und den ROI-Ausschnitt ins Modell-Format bringen.
+// Liest direkt aus dem Kamera-Framebuffer in den vorab allokierten Puffer von model_img.
+// Braucht der Detektor das 96x96-Modell, wird dasselbe ROI zusätzlich direkt aus dem
+// Framebuffer auf 96x96 skaliert (small_img), statt das 224x224-Bild noch einmal zu verkleinern.
+// Mit Sensor-Fenster enthält der Framebuffer nur einen Teil des Kamerabildes, das ROI wird
+// dann innerhalb dieses Fensters gehalten.
+static bool capture_image(dl::image::img_t &model_img, dl::image::img_t &small_img, frame::rect_t &roi) {
+    camera_fb_t *pic = camera::grab();
     if (!pic) {
         ESP_LOGE("CAM", "Failed to capture image");
         return false;
     }
-    dl::image::img_t img;
-    img.height = pic->height;
-    img.width = pic->width;
-    img.pix_type = dl::image::DL_IMAGE_PIX_TYPE_RGB565;
-    img.data = malloc(pic->len);
-    if (!img.data) {
-        ESP_LOGE("MEM", "Memory allocation failed");
-        esp_camera_fb_return(pic);
+    if (pic->width < roi_home.w || pic->height < roi_home.h) {
+        ESP_LOGE("CAM", "Frame %dx%d is smaller than the ROI %dx%d", pic->width, pic->height, roi_home.w, roi_home.h);
+        camera::release(pic);
         return false;
     }
+    // ROI in Framebuffer-Koordinaten
+    const frame::rect_t window = camera::window();
+    frame::rect_t local = {roi_x.load() - window.x, roi_y.load() - window.y, roi_home.w, roi_home.h};
+    frame::clamp_rect(local, pic->width, pic->height);
+    roi = {local.x + window.x, local.y + window.y, local.w, local.h};
+
+    profiler::Scope scope(profiler::STAGE_CROP);
+    roi_to_img(pic, local, model_img);
+    if (small_img.data) {
+        roi_to_img(pic, local, small_img);
+    }
+    camera::release(pic);
+    return true;
+}
 
-    memcpy(img.data, pic->buf, pic->len);
-    esp_camera_fb_return(pic);
+// RGB888-Bild zum Zeichnen und Speichern aus der Modell-Eingabe erzeugen.
+// Ist die Modell-Eingabe schon RGB888, teilen sich beide denselben Puffer.
+static void convert_to_rgb888(const dl::image::img_t &model_img, dl::image::img_t &rgb888_img) {
+    if (model_img.data == rgb888_img.data) {
+        return;
+    }
+    profiler::Scope scope(profiler::STAGE_CONVERT);
+    frame::crop_rgb565_to_rgb888(static_cast<const uint8_t *>(model_img.data), model_img.width,
+                                 0, 0, model_img.width, model_img.height,
+                                 static_cast<uint8_t *>(rgb888_img.data));
+}
+
+// Zählzonen in Kamera-Koordinaten, zählen Ein- und Ausflüge. Ohne Zonendatei auf der SD-Karte
+// eine waagerechte Linie (count_line_y in den Einstellungen). Die Zonen werden vor dem
+// Start der Pipeline gesetzt, danach zählt nur der Inferenz-Task und der Storage-Task liest sie.
+static counting::ZoneCounter zone_counter;
 
-    // RGB565 -> RGB888 (ohne Crop)
-    dl::image::img_t rgb888_img;
-    rgb888_img.height = img.height;
-    rgb888_img.width = img.width;
-    rgb888_img.pix_type = dl::image::DL_IMAGE_PIX_TYPE_RGB888;
-    rgb888_img.data = malloc(img.width * img.height * 3);
-    if (!rgb888_img.data) {
-        ESP_LOGE("MEM", "Failed to allocate rgb888 buffer");
-        free(img.data);
+static void load_zones() {
+    counting::zone_t zones[counting::MAX_ZONES];
+    int num = counting::load_zones(g_settings.zones_path, zones, counting::MAX_ZONES);
+    if (num > 0 && zone_counter.set_zones(zones, num)) {
+        return;
+    }
+    if (num == 0) {
+        ESP_LOGW("APP", "%s enthält keine Zonen", g_settings.zones_path);
+    }
+    ESP_LOGI("APP", "Zähllinie y = %d", g_settings.count_line_y);
+    zones[0] = counting::horizontal_line(g_settings.count_line_y);
+    zone_counter.set_zones(zones, 1);
+}
+
+#if CONFIG_BEESENSE_EVENT_LOG
+// Binäres Protokoll aller Detektionen und Zählungen auf der SD-Karte (menuconfig: BeeSense -> Event log)
+static eventlog::EventLog event_log(CONFIG_BEESENSE_EVENT_LOG_SYNC_MS);
+#endif
+
+// Tracker ordnet die Hummeln über die Frames hinweg einer Track-ID zu (menuconfig: BeeSense -> Tracking)
+static tracker::Tracker bumblebee_tracker({
+    .min_iou = CONFIG_BEESENSE_TRACK_MIN_IOU_PERCENT / 100.0f,
+    .max_distance = CONFIG_BEESENSE_TRACK_MAX_DISTANCE,
+    .min_hits = CONFIG_BEESENSE_TRACK_MIN_HITS,
+    .max_age = CONFIG_BEESENSE_TRACK_MAX_AGE,
+});
+
+#if CONFIG_BEESENSE_MOTION_GATE
+// Bewegungsfilter vor dem Modell (menuconfig: BeeSense -> Motion gate)
+static motion::MotionGate motion_gate({
+    .block_size = CONFIG_BEESENSE_MOTION_BLOCK_SIZE,
+    .cell_threshold = CONFIG_BEESENSE_MOTION_CELL_THRESHOLD,
+    .min_changed_cells = CONFIG_BEESENSE_MOTION_MIN_CELLS,
+    .background_shift = CONFIG_BEESENSE_MOTION_BACKGROUND_SHIFT,
+    .force_interval = CONFIG_BEESENSE_MOTION_FORCE_INTERVAL,
+});
+#endif
+
+// Welche Frames auf die SD-Karte kommen (menuconfig: BeeSense -> Save policy)
+static constexpr uint32_t save_modes = 0
+#if CONFIG_BEESENSE_SAVE_ALL
+    | save_policy::SAVE_ALL
+#endif
+#if CONFIG_BEESENSE_SAVE_DETECTIONS
+    | save_policy::SAVE_DETECTIONS
+#endif
+#if CONFIG_BEESENSE_SAVE_CROSSINGS
+    | save_policy::SAVE_CROSSINGS
+#endif
+    ;
+
+static save_policy::SavePolicy save_policy_engine({
+    .modes = save_modes,
+#if CONFIG_BEESENSE_SAVE_DETECTIONS
+    .min_score = CONFIG_BEESENSE_SAVE_MIN_SCORE_PERCENT / 100.0f,
+#else
+    .min_score = 1.0f,
+#endif
+    .pre_roll = CONFIG_BEESENSE_SAVE_PRE_ROLL,
+    .post_roll = CONFIG_BEESENSE_SAVE_POST_ROLL,
+    .keyframe_interval = CONFIG_BEESENSE_SAVE_KEYFRAME_INTERVAL,
+});
+
+static uint32_t now_ms() {
+    return uint32_t(esp_timer_get_time() / 1000);
+}
+
+#if CONFIG_BEESENSE_SCHEDULER
+// Bildrate nach Aktivität und Tageszeit (menuconfig: BeeSense -> Frame scheduler)
+static scheduler::Scheduler frame_scheduler({
+    .active_interval_ms = CONFIG_BEESENSE_SCHEDULER_ACTIVE_INTERVAL_MS,
+    .quiet_after_ms = CONFIG_BEESENSE_SCHEDULER_QUIET_AFTER_S * 1000,
+    .quiet_interval_ms = CONFIG_BEESENSE_SCHEDULER_QUIET_INTERVAL_MS,
+    .night_start_hour = CONFIG_BEESENSE_SCHEDULER_NIGHT_START,
+    .night_end_hour = CONFIG_BEESENSE_SCHEDULER_NIGHT_END,
+    .night_interval_ms = CONFIG_BEESENSE_SCHEDULER_NIGHT_INTERVAL_MS,
+    .power_down_min_ms = CONFIG_BEESENSE_SCHEDULER_POWER_DOWN_MIN_MS,
+});
+
+// Vom Inferenz-Task gesetzt, vom Capture-Task gelesen
+static std::atomic<uint32_t> last_activity_ms{0};
+
+// Lokale Stunde, -1 solange die RTC nicht gestellt ist
+static int local_hour() {
+    const time_t now = time(nullptr);
+    if (now < 1600000000) {
+        return -1;
+    }
+    struct tm tm;
+    localtime_r(&now, &tm);
+    return tm.tm_hour;
+}
+
+// Vor jeder Aufnahme warten, bei langen Pausen mit abgeschalteter Kamera.
+// Ist Light-Sleep aktiviert, schläft der Chip während vTaskDelay automatisch.
+// Gibt true zurück, wenn die Kamera dabei aus war.
+static bool pace_capture() {
+    const scheduler::plan_t plan = frame_scheduler.next(now_ms(), last_activity_ms.load(), local_hour());
+    if (plan.delay_ms == 0) {
         return false;
     }
-    dl::image::RGB5652RGB888<true, false> converter;
-    uint8_t* src = (uint8_t*)img.data;
-    uint8_t* dst = (uint8_t*)rgb888_img.data;
-    for (int i = 0; i < img.width * img.height; ++i) {
-        converter(src, dst);
-        src += 2;
-        dst += 3;
-    }
-
-    // Crop auf 224x224
-    cropped_img.height = MODEL_IMG_SIZE;
-    cropped_img.width = MODEL_IMG_SIZE;
-    cropped_img.pix_type = dl::image::DL_IMAGE_PIX_TYPE_RGB888;
-    cropped_img.data = malloc(MODEL_IMG_SIZE * MODEL_IMG_SIZE * 3);
-    if (!cropped_img.data) {
-        ESP_LOGE("MEM", "Failed to allocate cropped buffer");
-        free(img.data);
-        free(rgb888_img.data);
+    const bool powered_down = plan.power_down && camera::set_power(false);
+    vTaskDelay(pdMS_TO_TICKS(plan.delay_ms));
+    if (powered_down) {
+        // Bilder verwerfen, bis Belichtung und Weißabgleich wieder eingeschwungen sind
+        camera::set_power(true, CONFIG_BEESENSE_SCHEDULER_POWER_UP_SETTLE_FRAMES);
+    }
+    return powered_down;
+}
+#endif
+
+// --------- Pipeline-Stufen ----------------------------------
+
+// Capture-Task: neues Kamerabild in den Slot holen
+static bool capture_stage(pipeline::frame_t &frame) {
+    frame.power_cycled = false;
+#if CONFIG_BEESENSE_SCHEDULER
+    frame.power_cycled = pace_capture();
+#endif
+    if (!capture_image(frame.model_img, frame.small_img, frame.roi)) {
+        ESP_LOGE("CAM", "Could not take or convert picture");
         return false;
     }
-    int x0 = (rgb888_img.width - MODEL_IMG_SIZE) / 2;
-    int y0 = (rgb888_img.height - MODEL_IMG_SIZE) / 2;
-    for (int y = 0; y < MODEL_IMG_SIZE; ++y) {
-        int src_y = y0 + y;
-        memcpy(
-            (uint8_t*)cropped_img.data + y * MODEL_IMG_SIZE * 3,
-            (uint8_t*)rgb888_img.data + (src_y * rgb888_img.width + x0) * 3,
-            MODEL_IMG_SIZE * 3);
+    return true;
+}
+
+// Box von Modell-Koordinaten in Kamera-Koordinaten umrechnen, damit Tracks und Zähllinie
+// unabhängig von der Lage des ROI sind
+static tracker::box_t to_camera(int x1, int y1, int x2, int y2, float score, const frame::rect_t &roi) {
+    return {roi.x + x1 * roi.w / MODEL_IMG_SIZE, roi.y + y1 * roi.h / MODEL_IMG_SIZE,
+            roi.x + x2 * roi.w / MODEL_IMG_SIZE, roi.y + y2 * roi.h / MODEL_IMG_SIZE, score};
+}
+
+#if CONFIG_BEESENSE_ROI_FOLLOW_TRACKS
+// ROI auf den Mittelpunkt der aktiven Tracks legen, ohne Tracks zurück auf die Ausgangsposition.
+// Der Capture-Task hält das ROI innerhalb des Kamerabildes.
+static void follow_tracks() {
+    int n = 0, sum_x = 0, sum_y = 0;
+    for (int i = 0; i < bumblebee_tracker.num_tracks(); ++i) {
+        const tracker::track_t &track = bumblebee_tracker.track(i);
+        sum_x += track.cx;
+        sum_y += track.cy;
+        n++;
+    }
+    if (n == 0) {
+        roi_x = roi_home.x;
+        roi_y = roi_home.y;
+    } else {
+        roi_x = sum_x / n - roi_home.w / 2;
+        roi_y = sum_y / n - roi_home.h / 2;
+    }
+}
+#endif
+
+// Inferenz-Task: Modell ausführen, Hummeln filtern und zählen
+static void infer_stage(pipeline::frame_t &frame) {
+#if CONFIG_BEESENSE_MOTION_GATE
+    // Hat sich das ROI verschoben oder war die Kamera aus, passt der Hintergrund nicht mehr
+    static frame::rect_t last_roi = frame.roi;
+    if (frame.roi.x != last_roi.x || frame.roi.y != last_roi.y || frame.power_cycled) {
+        motion_gate.reset();
+    }
+    last_roi = frame.roi;
+#endif
+
+    // Ohne Bewegung und ohne aktive Tracks wird das Modell übersprungen.
+    // Der Hintergrund wird trotzdem mit jedem Frame nachgeführt.
+    bool run_model = true;
+    bool motion = false;
+#if CONFIG_BEESENSE_MOTION_GATE
+    {
+        profiler::Scope scope(profiler::STAGE_MOTION);
+        motion = motion_gate.update(static_cast<const uint8_t *>(frame.model_img.data),
+                                    frame.model_img.width, frame.model_img.height,
+                                    frame.model_img.pix_type == dl::image::DL_IMAGE_PIX_TYPE_RGB565);
+        run_model = motion || bumblebee_tracker.num_tracks() > 0;
+    }
+#endif
+
+    static std::list<dl::detect::result_t> no_results;
+    std::list<dl::detect::result_t> *detect_results = &no_results;
+    if (run_model) {
+        detect_results = detector::run(frame.model_img, bumblebee_tracker.num_tracks() > 0,
+                                       frame.small_img.data ? &frame.small_img : nullptr);
+        if (!detect_results) {
+            return;
+        }
+        ESP_LOGD(TAG, "Frame %lu: inference %lld us (model load at boot: %lld us)",
+                 frame.id, detector::last_inference_us(), detector::load_time_us());
+    } else {
+        ESP_LOGD(TAG, "Frame %lu: no motion, inference skipped", frame.id);
     }
 
-    free(img.data);
-    free(rgb888_img.data);
-    return true;
+    tracker::box_t boxes[pipeline::MAX_DETECTIONS];
+    float max_score = 0.0f;
+
+    for (const auto &res : *detect_results) {
+        // Bereits nach Score und Klasse gefiltert (detector::filter_t)
+        int x1 = res.box[0];
+        int y1 = res.box[1];
+        int x2 = res.box[2];
+        int y2 = res.box[3];
+        if (x2 < x1) std::swap(x1, x2);
+        if (y2 < y1) std::swap(y1, y2);
+        if (frame.num_detections < pipeline::MAX_DETECTIONS) {
+            boxes[frame.num_detections] = to_camera(x1, y1, x2, y2, res.score, frame.roi);
+            frame.detections[frame.num_detections++] = {x1, y1, x2, y2, res.score, 0};
+        }
+        max_score = std::max(max_score, res.score);
+
+        // Mittelpunkt im Serial Monitor ausgeben (Modell-Koordinaten), nur mit Debug-Log
+        ESP_LOGD(TAG, "Hummel-Mittelpunkt: x=%d, y=%d", (x1 + x2) / 2, (y1 + y2) / 2);
+    }
+
+    // Detektionen den Tracks zuordnen, jede Box bekommt ihre Track-ID
+    uint32_t track_ids[pipeline::MAX_DETECTIONS];
+    int64_t track_start = esp_timer_get_time();
+    bumblebee_tracker.update(boxes, frame.num_detections, track_ids);
+    for (int i = 0; i < frame.num_detections; ++i) {
+        frame.detections[i].track_id = track_ids[i];
+    }
+
+    // Zähl-Logik: Jeder bestätigte Track, der dabei eine Zone überquert hat, wird dort genau einmal gezählt.
+    // Die Richtung legt jede Zone selbst fest (Standardlinie: von oben nach unten = Ausflug)
+    const int crossings = zone_counter.update(bumblebee_tracker);
+    const int64_t track_us = esp_timer_get_time() - track_start;
+    profiler::record(profiler::STAGE_TRACKING, track_us);
+    ESP_LOGD(TAG, "Tracking: %d Tracks in %lld us", bumblebee_tracker.num_tracks(), track_us);
+
+#if CONFIG_BEESENSE_ROI_FOLLOW_TRACKS
+    follow_tracks();
+#endif
+
+    // Pro Frame nur bei einer Zählung, der Stand steht sonst alle 10 s in der Tracker-Statistik
+    if (crossings > 0) {
+        ESP_LOGI(TAG, "Einflüge: %d, Ausflüge: %d", zone_counter.einflug(), zone_counter.ausflug());
+    }
+
+#if CONFIG_BEESENSE_SCHEDULER
+    // Bewegung, Hummeln oder laufende Tracks halten den Scheduler im schnellen Modus
+    if (motion || frame.num_detections > 0 || bumblebee_tracker.num_tracks() > 0) {
+        last_activity_ms = now_ms();
+    }
+#else
+    (void)motion;
+#endif
+
+#if CONFIG_BEESENSE_EVENT_LOG
+    // Boxen (Kamera-Koordinaten) und Überquerungen ins Protokoll, geschrieben wird blockweise
+    const uint32_t time_ms = now_ms();
+    for (int i = 0; i < frame.num_detections; ++i) {
+        const tracker::box_t &b = boxes[i];
+        event_log.detection(time_ms, frame.id, track_ids[i], b.x1, b.y1, b.x2, b.y2, b.score);
+    }
+    for (int i = 0; i < zone_counter.num_last_crossings(); ++i) {
+        const counting::crossing_t &c = zone_counter.last_crossing(i);
+        event_log.crossing(time_ms, frame.id, c.track_id, c.zone, c.direction, zone_counter.einflug(c.zone),
+                           zone_counter.ausflug(c.zone));
+    }
+    event_log.tick(time_ms);
+#endif
+
+    // Nur Frames speichern, die laut Save-Policy relevant sind
+    save_policy::decision_t decision = save_policy_engine.evaluate({frame.num_detections, max_score, crossings});
+    frame.save = decision.save;
+    frame.flush_pre_roll = decision.flush_pre_roll;
+
+    // Im Benchmark-Modus alle N Frames Latenz-Histogramme ausgeben
+    profiler::frame_done();
+}
+
+// Kante einer Zone (Kamera-Koordinaten) grün und 2 px breit ins Modellbild zeichnen.
+// Die Strecke wird vorher auf das Bild beschnitten, die Standardlinie reicht weit darüber hinaus.
+static void draw_zone_edge(dl::image::img_t &img, const frame::rect_t &roi, counting::point_t a, counting::point_t b) {
+    float x0 = float(a.x - roi.x) * MODEL_IMG_SIZE / roi.w;
+    float y0 = float(a.y - roi.y) * MODEL_IMG_SIZE / roi.h;
+    const float dx = float(b.x - roi.x) * MODEL_IMG_SIZE / roi.w - x0;
+    const float dy = float(b.y - roi.y) * MODEL_IMG_SIZE / roi.h - y0;
+
+    // Liang-Barsky: Parameterbereich [t0, t1] der Strecke innerhalb des Bildes
+    const float p[4] = {-dx, dx, -dy, dy};
+    const float q[4] = {x0, MODEL_IMG_SIZE - 1 - x0, y0, MODEL_IMG_SIZE - 1 - y0};
+    float t0 = 0.0f, t1 = 1.0f;
+    for (int i = 0; i < 4; ++i) {
+        if (p[i] == 0.0f) {
+            if (q[i] < 0.0f) {
+                return;
+            }
+        } else if (p[i] < 0.0f) {
+            t0 = std::max(t0, q[i] / p[i]);
+        } else {
+            t1 = std::min(t1, q[i] / p[i]);
+        }
+    }
+    if (t0 > t1) {
+        return;
+    }
+
+    const int steps = int(std::max(std::abs(dx), std::abs(dy)) * (t1 - t0)) + 1;
+    uint8_t *pixels = static_cast<uint8_t *>(img.data);
+    for (int s = 0; s <= steps; ++s) {
+        const float t = t0 + (t1 - t0) * s / steps;
+        const int x = int(x0 + dx * t);
+        const int y = int(y0 + dy * t);
+        for (int k = 0; k < 2; ++k) {
+            const int py = std::min(y + k, MODEL_IMG_SIZE - 1);
+            uint8_t *px = pixels + (py * MODEL_IMG_SIZE + x) * 3;
+            px[0] = 0;
+            px[1] = 255;
+            px[2] = 0;
+        }
+    }
+}
+
+// Storage-Task: RGB888 erzeugen, BBoxen und Zonen einzeichnen, als JPEG speichern
+static void store_stage(pipeline::frame_t &frame) {
+    dl::image::img_t &img = frame.rgb888_img;
+
+    // RGB888 wird nur noch für das gespeicherte Bild gebraucht
+    convert_to_rgb888(frame.model_img, img);
+
+    {
+        profiler::Scope scope(profiler::STAGE_DRAW);
+
+        // Zählzonen zeichnen (grün), soweit sie im ROI liegen
+        for (int z = 0; z < zone_counter.num_zones(); ++z) {
+            const counting::zone_t &zone = zone_counter.zone(z);
+            const int edges = zone.type == counting::ZONE_LINE ? 1 : zone.num_points;
+            for (int e = 0; e < edges; ++e) {
+                draw_zone_edge(img, frame.roi, zone.points[e], zone.points[(e + 1) % zone.num_points]);
+            }
+        }
+
+        static const std::vector<uint8_t> color = {255, 0, 0}; // Rot
+        for (int i = 0; i < frame.num_detections; ++i) {
+            const pipeline::detection_t &det = frame.detections[i];
+            dl::image::draw_hollow_rectangle(img, det.x1, det.y1, det.x2, det.y2, color, 2);
+        }
+    }
+
+    // Bild mit BBoxen und Zonen speichern
+    dl::cls::result_t dummy_result = {};
+    sdcard::save_detected_jpeg(img, dummy_result, g_settings.image_dir);
+}
+
+// Eingelesene Einstellungen an die Module weitergeben, bevor die Pipeline startet
+static void apply_settings() {
+    sdcard::set_jpeg_quality(g_settings.jpeg_quality);
+
+    save_policy::config_t policy_cfg = save_policy_engine.config();
+#if CONFIG_BEESENSE_SAVE_DETECTIONS
+    policy_cfg.min_score = g_settings.save_min_score;
+#endif
+    save_policy_engine = save_policy::SavePolicy(policy_cfg);
+
+#if CONFIG_BEESENSE_SCHEDULER
+    frame_scheduler = scheduler::Scheduler({
+        .active_interval_ms = g_settings.active_interval_ms,
+        .quiet_after_ms = g_settings.quiet_after_s * 1000,
+        .quiet_interval_ms = g_settings.quiet_interval_ms,
+        .night_start_hour = g_settings.night_start_hour,
+        .night_end_hour = g_settings.night_end_hour,
+        .night_interval_ms = g_settings.night_interval_ms,
+        .power_down_min_ms = g_settings.power_down_min_ms,
+    });
+#endif
 }
 
 extern "C" void app_main(void)
@@ -144,7 +502,56 @@ extern "C" void app_main(void)
         return;
     }
 
-    if (ESP_OK != init_camera()) {
+    // Einstellungen von der SD-Karte, fehlt die Datei, bleiben die Defaults
+    if (settings::load(CONFIG_BEESENSE_SETTINGS_PATH, g_settings) < 0) {
+        ESP_LOGI("APP", "%s nicht gefunden, Defaults aktiv", CONFIG_BEESENSE_SETTINGS_PATH);
+    }
+    settings::dump(g_settings);
+    apply_settings();
+
+    // Zählzonen von der SD-Karte, sonst die Zähllinie aus den Einstellungen
+    load_zones();
+
+    // JPEGs werden asynchron geschrieben, ohne Writer-Task wird synchron gespeichert
+    if (!sdwriter::start()) {
+        ESP_LOGW("SD", "SD writer could not be started, saving synchronously");
+    }
+
+#if CONFIG_BEESENSE_EVENT_LOG
+    // Uhrzeit nur übernehmen, wenn die RTC gestellt ist
+    const time_t unix_time = time(nullptr);
+    if (!event_log.open(g_settings.event_log_path, now_ms(),
+                        unix_time > 1600000000 ? uint32_t(unix_time) : 0)) {
+        ESP_LOGW("SD", "Event log could not be opened, counts are only logged to the console");
+    }
+#endif
+
+#if CONFIG_BEESENSE_SCHEDULER_LIGHT_SLEEP
+    // Automatischer Light-Sleep, solange alle Tasks warten. Die Kamera verhindert ihn, solange sie an ist.
+    esp_pm_config_t pm_config = {
+        .max_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .light_sleep_enable = true,
+    };
+    if (esp_pm_configure(&pm_config) != ESP_OK) {
+        ESP_LOGW("APP", "Light sleep could not be enabled");
+    }
+#endif
+
+    // Kamera: Anzahl Framebuffer, Grab-Modus und Sensor-Fenster (menuconfig: BeeSense -> Camera)
+    camera::config_t camera_cfg = {
+        .fb_count = CONFIG_BEESENSE_CAMERA_FB_COUNT,
+        .grab_latest = false,
+        .sensor_window = false,
+        .roi = roi_home,
+    };
+#if CONFIG_BEESENSE_CAMERA_GRAB_LATEST
+    camera_cfg.grab_latest = true;
+#endif
+#if CONFIG_BEESENSE_CAMERA_SENSOR_WINDOW
+    camera_cfg.sensor_window = true;
+#endif
+    if (!camera::init(camera_cfg)) {
         ESP_LOGE("APP", "Camera initialization failed");
         return;
     }
@@ -153,94 +560,87 @@ extern "C" void app_main(void)
         ESP_ERROR_CHECK(bsp_sdcard_mount());
     #endif
 
-    // Zählvariablen für Ein- und Ausflüge
-    int einflug_count = 0;
-    int ausflug_count = 0;
-    const int y_line = 120; // Zähllinie
-    // Für einfaches Tracking: Merke dir die y-Positionen der Hummeln aus dem letzten Frame
-    std::vector<int> last_centers_y;
-
-    while (true) {
-        ESP_LOGI("MEM", "Free heap at start of loop: %lu bytes", esp_get_free_heap_size());
-
-        dl::image::img_t cropped_img;
-        if (!capture_and_convert_image(cropped_img)) {
-            ESP_LOGE("CAM", "Could not take or convert picture");
-            vTaskDelay(pdMS_TO_TICKS(500));
-            continue;
-        }
+    // Modell einmalig beim Booten laden, nicht in jedem Durchlauf
+    // Modell-Auswahl (menuconfig: BeeSense -> Detector)
+#if CONFIG_BEESENSE_MODEL_96
+    const detector::mode_t detector_mode = detector::MODE_96;
+#elif CONFIG_BEESENSE_MODEL_ADAPTIVE
+    const detector::mode_t detector_mode = detector::MODE_ADAPTIVE;
+#else
+    const detector::mode_t detector_mode = detector::MODE_224;
+#endif
+    // Score- und Klassenfilter wirken schon im Postprocessing, run() liefert nur noch Hummeln
+    const detector::filter_t detector_filter = {g_settings.score_thr, g_settings.class_mask};
+    if (!detector::init(detector_mode, detector_filter, g_settings.escalate_score, g_settings.model_nms_thr)) {
+        ESP_LOGE("APP", "Detector initialization failed");
+        return;
+    }
 
-        BumblebeeDetect *detect = new BumblebeeDetect();
-        auto &detect_results = detect->run(cropped_img);
-        int result_count = 0;
-        std::vector<int> current_centers_y;
-
-        // Zähllinie zeichnen (grün)
-        std::vector<uint8_t> line_color = {0, 255, 0};
-        dl::image::draw_hollow_rectangle(cropped_img, 0, y_line, MODEL_IMG_SIZE-1, y_line+1, line_color, 2);
-
-        for (const auto &res : detect_results) {
-            if (res.category == 0 && res.score > 0.35f) {
-                int x1 = res.box[0];
-                int y1 = res.box[1];
-                int x2 = res.box[2];
-                int y2 = res.box[3];
-                if (x2 < x1) std::swap(x1, x2);
-                if (y2 < y1) std::swap(y1, y2);
-                std::vector<uint8_t> color = {255, 0, 0}; // Rot
-                dl::image::draw_hollow_rectangle(cropped_img, x1, y1, x2, y2, color, 2);
-                ++result_count;
-
-                // Mittelpunkt der Box berechnen
-                int center_x = (x1 + x2) / 2;
-                int center_y = (y1 + y2) / 2;
-                current_centers_y.push_back(center_y);
-
-                // Mittelpunkt im Serial Monitor ausgeben
-                ESP_LOGI(TAG, "Hummel-Mittelpunkt: x=%d, y=%d", center_x, center_y);
-
-                // Auswertung: Liegt Mittelpunkt über oder unter der Linie?
-                ESP_LOGI(TAG, "Hummel-Mitte y=%d, Linie y=%d", center_y, y_line);
-            }
-        }
+    // Aufnahme, Inferenz und Speichern laufen als eigene Tasks auf beiden Kernen,
+    // die Frames wandern über Queues mit vorab allokierten Puffern
+    pipeline::config_t pipeline_cfg = {
+        .img_size = MODEL_IMG_SIZE,
+        .model_pix_type = MODEL_INPUT_RGB565 ? dl::image::DL_IMAGE_PIX_TYPE_RGB565 : dl::image::DL_IMAGE_PIX_TYPE_RGB888,
+        .small_img_size = detector_mode == detector::MODE_224 ? 0 : detector::SMALL_IMG_SIZE,
+        .capture = capture_stage,
+        .infer = infer_stage,
+        .store = store_stage,
+        .pre_roll = CONFIG_BEESENSE_SAVE_PRE_ROLL,
+    };
+    if (!pipeline::start(pipeline_cfg)) {
+        ESP_LOGE("APP", "Pipeline start failed");
+        return;
+    }
 
-        // Einfache Zähl-Logik: Wenn eine Hummel von unterhalb nach oberhalb der Linie wechselt = Einflug
-        // Wenn von oberhalb nach unterhalb = Ausflug
-        // (Vereinfachte Annahme: Nur Positionswechsel zwischen zwei Frames)
-        for (size_t i = 0; i < current_centers_y.size(); ++i) {
-            int curr_y = current_centers_y[i];
-            // Suche im letzten Frame nach einem ähnlichen Mittelpunkt
-            for (size_t j = 0; j < last_centers_y.size(); ++j) {
-                int last_y = last_centers_y[j];
-                if (abs(curr_y - last_y) < 30) { // Annahme: gleiche Hummel
-                    // Von oben nach unten: Ausflug
-                    if (last_y < y_line && curr_y >= y_line) {
-                        ausflug_count++;
-                        ESP_LOGI(TAG, "Ausflug erkannt!");
-                    } 
-                    // Von unten nach oben: Einflug
-                    else if (last_y > y_line && curr_y <= y_line) {
-                        einflug_count++;
-                        ESP_LOGI(TAG, "Einflug erkannt!");
-                    }
-                }
-            }
+    // Durchsatz alle 10 Sekunden ausgeben
+    pipeline::stats_t last = pipeline::get_stats();
+    while (true) {
+        vTaskDelay(pdMS_TO_TICKS(10000));
+        pipeline::stats_t now = pipeline::get_stats();
+        ESP_LOGI("APP", "%.1f fps inferred, captured %lu (failed %lu), inferred %lu, stored %lu, free heap %lu bytes",
+                 (now.inferred - last.inferred) / 10.0f, now.captured, now.capture_failed, now.inferred, now.stored,
+                 esp_get_free_heap_size());
+#if CONFIG_BEESENSE_ALLOC_COUNTER
+        // Im eingeschwungenen Zustand sollten die Pipeline-Tasks nichts mehr allokieren
+        ESP_LOGI("APP", "heap allocations in the last 10 s: capture %lu, inference %lu, storage %lu",
+                 now.allocs_capture - last.allocs_capture, now.allocs_inference - last.allocs_inference,
+                 now.allocs_storage - last.allocs_storage);
+#endif
+        camera::stats_t cam = camera::get_stats();
+        ESP_LOGI("CAM", "%lu frames, %lu failed, frame age avg %lld us, max %lld us",
+                 cam.frames, cam.failed, cam.frames ? cam.age_us_sum / cam.frames : 0, cam.age_us_max);
+#if CONFIG_BEESENSE_SCHEDULER
+        const scheduler::stats_t &fs = frame_scheduler.stats();
+        for (int m = 0; m < scheduler::MODE_COUNT; ++m) {
+            const scheduler::mode_t mode = scheduler::mode_t(m);
+            ESP_LOGI("APP", "scheduler %-6s: %lu frames, %llu s, duty cycle %.1f %%", scheduler::mode_name(mode),
+                     fs.frames[m], fs.mode_ms[m] / 1000, frame_scheduler.duty_cycle(mode) * 100.0f);
         }
-        last_centers_y = current_centers_y;
-
-        ESP_LOGI(TAG, "Einflüge: %d, Ausflüge: %d", einflug_count, ausflug_count);
-
-        // Bild mit BBoxen und Linie speichern (optional)
-        dl::cls::result_t dummy_result = {};
-        sdcard::save_detected_jpeg(cropped_img, dummy_result, "/sdcard/bumblebee_tracking");
-
-        delete detect;
-        heap_caps_free(cropped_img.data);
-
-        vTaskDelay(pdMS_TO_TICKS(500)); // 500ms Intervall
+        ESP_LOGI("APP", "scheduler: %lu mode switches, camera powered down %lu times",
+                 fs.switches, cam.power_downs);
+#endif
+        const save_policy::stats_t &sp = save_policy_engine.stats();
+        ESP_LOGI("APP", "save policy: %lu events, %lu of %lu frames saved (%lu keyframes, %lu pre-roll)",
+                 sp.events, sp.saved, sp.frames, sp.keyframes, now.pre_roll_stored);
+        detector::stats_t det = detector::get_stats();
+        ESP_LOGI("APP", "detector: %lu runs 224x224, %lu runs 96x96, %lu escalations, %lu without postprocessing",
+                 det.runs_224, det.runs_96, det.escalations, det.gated);
+#if CONFIG_BEESENSE_MOTION_GATE
+        const motion::stats_t &mg = motion_gate.stats();
+        ESP_LOGI("APP", "motion gate: %lu of %lu frames with motion, %lu forced",
+                 mg.motion, mg.frames, mg.forced);
+#endif
+        const tracker::stats_t &tr = bumblebee_tracker.stats();
+        ESP_LOGI("APP", "tracker: %d active, %lu created, %lu confirmed, %lu expired; Einflüge %d, Ausflüge %d",
+                 bumblebee_tracker.num_tracks(), tr.created, tr.confirmed, tr.expired, zone_counter.einflug(), zone_counter.ausflug());
+#if CONFIG_BEESENSE_EVENT_LOG
+        const eventlog::stats_t &ev = event_log.stats();
+        ESP_LOGI("SD", "event log: %lu records, %lu blocks, %lu syncs, %lu errors, %lu blocks lost",
+                 ev.records, ev.blocks, ev.syncs, ev.errors, ev.lost);
+#endif
+        sdwriter::stats_t sd = sdwriter::get_stats();
+        ESP_LOGI("SD", "queued %lu, written %lu, dropped %lu, errors %lu, ring low-water %u of %u bytes free",
+                 sd.queued, sd.written, sd.dropped, sd.write_errors, (unsigned)sd.min_free, (unsigned)sd.ring_size);
+        last = now;
     }
-
-    #if CONFIG_BUMBLEBEE_DETECT_MODEL_IN_SDCARD
-        ESP_ERROR_CHECK(bsp_sdcard_unmount());
-    #endif
 }
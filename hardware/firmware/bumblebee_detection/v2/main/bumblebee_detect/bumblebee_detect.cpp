@@ -1,5 +1,7 @@
 #include "bumblebee_detect.hpp"
+#include "score_gate.hpp"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include <filesystem>
 
 #if CONFIG_BUMBLEBEE_DETECT_MODEL_IN_FLASH_RODATA
@@ -13,7 +15,7 @@ static const char *path = "bumblebee_det";
 #endif
 #endif
 namespace bumblebee_detect {
-ESPDet::ESPDet(const char *model_name, float score_thr, float nms_thr)
+ESPDet::ESPDet(const char *model_name, const filter_t &filter, float nms_thr) : m_filter(filter)
 {
 #if !CONFIG_BUMBLEBEE_DETECT_MODEL_IN_SDCARD
     m_model =
@@ -31,16 +33,97 @@ ESPDet::ESPDet(const char *model_name, float score_thr, float nms_thr)
 #endif
     m_image_preprocessor->enable_letterbox({114, 114, 114});
     m_postprocessor = new dl::detect::ESPDetPostProcessor(
-        m_model, m_image_preprocessor, score_thr, nms_thr, 10, {{8, 8, 4, 4}, {16, 16, 8, 8}, {32, 32, 16, 16}});
+        m_model, m_image_preprocessor, filter.score_thr, nms_thr, 10, {{8, 8, 4, 4}, {16, 16, 8, 8}, {32, 32, 16, 16}});
+
+    // score0..score2, one per stride, next to the box outputs
+    for (auto &output : m_model->get_outputs()) {
+        if (output.first.compare(0, 5, "score") == 0) {
+            m_score_outputs.push_back({output.second, 0});
+        }
+    }
+    if (m_score_outputs.empty()) {
+        ESP_LOGW("bumblebee_detect", "%s has no score outputs, every run is postprocessed", model_name);
+    }
+    set_filter(filter);
+}
+
+void ESPDet::set_filter(const filter_t &filter)
+{
+    m_filter = filter;
+    m_postprocessor->set_score_thr(filter.score_thr);
+    for (auto &output : m_score_outputs) {
+        output.thr = quantized_logit(filter.score_thr, output.tensor->exponent);
+    }
+}
+
+bool ESPDet::any_score_passes() const
+{
+    if (m_score_outputs.empty()) {
+        return true;
+    }
+    for (const auto &output : m_score_outputs) {
+        switch (output.tensor->dtype) {
+        case dl::DATA_TYPE_INT8:
+            if (any_above(static_cast<const int8_t *>(output.tensor->data), output.tensor->get_size(),
+                          output.tensor->shape.back(), output.thr, m_filter.class_mask)) {
+                return true;
+            }
+            break;
+        case dl::DATA_TYPE_INT16:
+            if (any_above(static_cast<const int16_t *>(output.tensor->data), output.tensor->get_size(),
+                          output.tensor->shape.back(), output.thr, m_filter.class_mask)) {
+                return true;
+            }
+            break;
+        default:
+            // Float outputs are not gated
+            return true;
+        }
+    }
+    return false;
+}
+
+std::list<dl::detect::result_t> &ESPDet::run(const dl::image::img_t &img)
+{
+    int64_t start = esp_timer_get_time();
+    m_image_preprocessor->preprocess(img);
+    int64_t preprocessed = esp_timer_get_time();
+
+    m_model->run();
+    int64_t forwarded = esp_timer_get_time();
+
+    m_postprocessor->clear_result();
+#if CONFIG_BUMBLEBEE_DETECT_QUANTIZED_SCORE_GATE
+    m_gated = !any_score_passes();
+#endif
+    if (!m_gated) {
+        m_postprocessor->postprocess();
+    }
+    std::list<dl::detect::result_t> &result = m_postprocessor->get_result(img.width, img.height);
+    // The postprocessor rounds the threshold to its own quantization and knows no class filter,
+    // at most top-k results are left to check
+    result.remove_if([this](const dl::detect::result_t &res) {
+        return res.score <= m_filter.score_thr || res.category >= 32 || !(m_filter.class_mask >> res.category & 1);
+    });
+    int64_t end = esp_timer_get_time();
+
+    m_timing.preprocess_us = preprocessed - start;
+    m_timing.model_us = forwarded - preprocessed;
+    m_timing.postprocess_us = end - forwarded;
+    return result;
 }
 
 } // namespace bumblebee_detect
 
 
-BumblebeeDetect::BumblebeeDetect(bool lazy_load)
+BumblebeeDetect::BumblebeeDetect(model_type_t model_type,
+                                 bool lazy_load,
+                                 const bumblebee_detect::ESPDet::filter_t &filter,
+                                 float nms_thr) :
+    m_model_type(model_type), m_filter(filter)
 {
-    m_score_thr[0] = bumblebee_detect::ESPDet::default_score_thr;
-    m_nms_thr[0] = bumblebee_detect::ESPDet::default_nms_thr;
+    m_score_thr[0] = filter.score_thr;
+    m_nms_thr[0] = nms_thr;
     if (lazy_load) {
         m_model = nullptr;
     } else {
@@ -50,9 +133,46 @@ BumblebeeDetect::BumblebeeDetect(bool lazy_load)
 
 void BumblebeeDetect::load_model()
 {
+    switch (m_model_type) {
+    case ESPDET_PICO_224_224_BUMBLEBEE:
     #if CONFIG_FLASH_ESPDET_PICO_224_224_BUMBLEBEE || CONFIG_BUMBLEBEE_DETECT_MODEL_IN_SDCARD
-        m_model = new bumblebee_detect::ESPDet("espdet_pico_224_224_bumblebee.espdl", m_score_thr[0], m_nms_thr[0]);
+        m_model = new bumblebee_detect::ESPDet("espdet_pico_224_224_bumblebee.espdl", m_filter, m_nms_thr[0]);
     #else
         ESP_LOGE("bumblebee_detect", "espdet_pico_224_224_bumblebee is not selected in menuconfig.");
     #endif
+        break;
+    case ESPDET_PICO_96_96_BUMBLEBEE:
+    #if CONFIG_FLASH_ESPDET_PICO_96_96_BUMBLEBEE || CONFIG_BUMBLEBEE_DETECT_MODEL_IN_SDCARD
+        m_model = new bumblebee_detect::ESPDet("espdet_pico_96_96_bumblebee.espdl", m_filter, m_nms_thr[0]);
+    #else
+        ESP_LOGE("bumblebee_detect", "espdet_pico_96_96_bumblebee is not selected in menuconfig.");
+    #endif
+        break;
+    }
+}
+
+void BumblebeeDetect::set_filter(const bumblebee_detect::ESPDet::filter_t &filter)
+{
+    m_filter = filter;
+    m_score_thr[0] = filter.score_thr;
+    if (m_model) {
+        static_cast<bumblebee_detect::ESPDet *>(m_model)->set_filter(filter);
+    }
+}
+
+bool BumblebeeDetect::reload()
+{
+    delete m_model;
+    m_model = nullptr;
+    load_model();
+    return m_model != nullptr;
+}
+
+bool BumblebeeDetect::set_model_type(model_type_t model_type)
+{
+    if (model_type == m_model_type && m_model) {
+        return true;
+    }
+    m_model_type = model_type;
+    return reload();
 }
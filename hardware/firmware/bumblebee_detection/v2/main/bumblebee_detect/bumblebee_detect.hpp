@@ -1,20 +1,89 @@
 #pragma once
 #include "dl_detect_base.hpp"
 #include "dl_detect_espdet_postprocessor.hpp"
+#include <vector>
 
 namespace bumblebee_detect {
 class ESPDet : public dl::detect::DetectImpl {
 public:
     static inline constexpr float default_score_thr = 0.3;
     static inline constexpr float default_nms_thr = 0.7;
-    ESPDet(const char *model_name, float score_thr, float nms_thr);
+    static inline constexpr uint32_t all_classes = 0xffffffff;
+    // What run() returns. The score threshold is applied inside the postprocessor, so
+    // anchors below it are neither decoded nor part of NMS.
+    struct filter_t {
+        float score_thr;     // keep scores strictly above, a score equal to it is dropped
+        uint32_t class_mask; // bit c keeps category c
+    };
+    // Duration of the three steps of the last run()
+    struct timing_t {
+        int64_t preprocess_us;
+        int64_t model_us;
+        int64_t postprocess_us;
+    };
+
+    ESPDet(const char *model_name, const filter_t &filter, float nms_thr);
+
+    // Same steps as DetectImpl::run, but timed and filtered
+    std::list<dl::detect::result_t> &run(const dl::image::img_t &img) override;
+    const timing_t &last_timing() const { return m_timing; }
+    // Takes effect with the next run()
+    void set_filter(const filter_t &filter);
+    const filter_t &filter() const { return m_filter; }
+    // true if the last run() found no quantized score above the threshold and skipped the postprocessor
+    bool last_run_gated() const { return m_gated; }
+
+private:
+    // Score output of one stride and the threshold as a quantized logit of that tensor
+    struct score_output_t {
+        dl::TensorBase *tensor;
+        int32_t thr;
+    };
+
+    bool any_score_passes() const;
+
+    filter_t m_filter;
+    std::vector<score_output_t> m_score_outputs;
+    timing_t m_timing = {};
+    bool m_gated = false;
 };
 } // namespace bumblebee_detect
 
 class BumblebeeDetect : public dl::detect::DetectWrapper {
 public:
-    BumblebeeDetect(bool lazy_load = true);
+    typedef enum {
+        ESPDET_PICO_224_224_BUMBLEBEE,
+        ESPDET_PICO_96_96_BUMBLEBEE,
+    } model_type_t;
+
+    BumblebeeDetect(model_type_t model_type = static_cast<model_type_t>(CONFIG_DEFAULT_BUMBLEBEE_DETECT_MODEL),
+                    bool lazy_load = true,
+                    const bumblebee_detect::ESPDet::filter_t &filter = {bumblebee_detect::ESPDet::default_score_thr,
+                                                                        bumblebee_detect::ESPDet::all_classes},
+                    float nms_thr = bumblebee_detect::ESPDet::default_nms_thr);
+
+    // Drop the loaded model and load it again, e.g. after a new model was flashed or copied to the SD card.
+    bool reload();
+    // Switch to another model, the current one is freed first.
+    bool set_model_type(model_type_t model_type);
+    model_type_t model_type() const { return m_model_type; }
+    // Kept across reload() and set_model_type()
+    void set_filter(const bumblebee_detect::ESPDet::filter_t &filter);
+    const bumblebee_detect::ESPDet::filter_t &filter() const { return m_filter; }
+    bool is_loaded() const { return m_model != nullptr; }
+    // Step timings of the last run(), nullptr if no model is loaded
+    const bumblebee_detect::ESPDet::timing_t *last_timing() const
+    {
+        return m_model ? &static_cast<const bumblebee_detect::ESPDet *>(m_model)->last_timing() : nullptr;
+    }
+    bool last_run_gated() const
+    {
+        return m_model && static_cast<const bumblebee_detect::ESPDet *>(m_model)->last_run_gated();
+    }
 
 private:
     void load_model() override;
+
+    model_type_t m_model_type;
+    bumblebee_detect::ESPDet::filter_t m_filter;
 };
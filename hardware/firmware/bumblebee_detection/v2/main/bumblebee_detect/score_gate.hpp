@@ -0,0 +1,40 @@
+#pragma once
+// Quantized score gate of ESPDet, without esp-dl types so the host tests can include it.
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+
+namespace bumblebee_detect {
+// q such that sigmoid(x * 2^exponent) > score_thr exactly when x > q, for the integer
+// scores x of a tensor with that exponent. In double: in float the logit of thresholds
+// next to a grid point rounds across it and q is one off, in both directions.
+inline int32_t quantized_logit(float score_thr, int exponent)
+{
+    if (score_thr <= 0.0f) {
+        return INT32_MIN;
+    }
+    if (score_thr >= 1.0f) {
+        return INT32_MAX;
+    }
+    const double logit = log(double(score_thr) / (1.0 - double(score_thr)));
+    return static_cast<int32_t>(floor(ldexp(logit, -exponent)));
+}
+
+// Scores are NHWC with `channels` values per anchor, one per class. Returns at the first
+// passing anchor, a full scan only happens on frames without a candidate, where it saves
+// the postprocessor.
+template <typename T>
+bool any_above(const T *q, int size, int channels, int32_t thr, uint32_t class_mask)
+{
+    const int classes = std::min(channels, 32);
+    for (int i = 0; i < size; i += channels) {
+        for (int c = 0; c < classes; ++c) {
+            if (q[i + c] > thr && (class_mask >> c & 1)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+} // namespace bumblebee_detect
@@ -0,0 +1,164 @@
+#include "file_naming.hpp"
+
+#include <sys/stat.h>
+#include <dirent.h>
+#include <errno.h>
+#include <strings.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "esp_log.h"
+
+namespace naming {
+
+static const char *TAG = "NAMING";
+
+// --------- Internal helpers ----------------------------------
+
+// Highest numbered shard subdirectory in path, -1 if there is none.
+static int scan_highest_shard(const char *path) {
+    DIR *dir = opendir(path);
+    if (!dir) {
+        return -1;
+    }
+
+    int highest = -1;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (entry->d_type != DT_DIR || !isdigit((unsigned char)entry->d_name[0])) {
+            continue;
+        }
+        int shard = atoi(entry->d_name);
+        if (shard > highest) {
+            highest = shard;
+        }
+    }
+
+    closedir(dir);
+    return highest;
+}
+
+static void shard_path(const char *base, int shard, char *out, size_t out_len) {
+    std::snprintf(out, out_len, "%s/%04d", base, shard);
+}
+
+// --------- FileNamer ----------------------------------
+
+FileNamer::FileNamer(int files_per_dir, const char *prefix, const char *extension) :
+    m_files_per_dir(files_per_dir), m_prefix(prefix), m_extension(extension), m_counters{}, m_num_counters(0)
+{
+}
+
+// Highest index of the <prefix>XXXXXX files in path, 0 if there are none.
+// Only the names are parsed, no stat() per entry.
+int FileNamer::scan_highest_index(const char *path) const
+{
+    DIR *dir = opendir(path);
+    if (!dir) {
+        ESP_LOGE(TAG, "Failed to open directory: %s", path);
+        return -1;
+    }
+
+    const size_t prefix_len = strlen(m_prefix);
+    int highest = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != nullptr) {
+        if (strncasecmp(entry->d_name, m_prefix, prefix_len) != 0) {
+            continue;
+        }
+        int idx = atoi(entry->d_name + prefix_len);
+        if (idx > highest) {
+            highest = idx;
+        }
+    }
+
+    closedir(dir);
+    return highest;
+}
+
+// Counter for dir_full_path, recovered from the directory on first use.
+FileNamer::dir_counter_t *FileNamer::get_counter(const char *dir_full_path)
+{
+    for (int i = 0; i < m_num_counters; ++i) {
+        if (strcmp(m_counters[i].path, dir_full_path) == 0) {
+            return &m_counters[i];
+        }
+    }
+
+    if (m_num_counters == MAX_DIRS || strlen(dir_full_path) >= sizeof(m_counters[0].path)) {
+        ESP_LOGE(TAG, "No file counter available for %s", dir_full_path);
+        return nullptr;
+    }
+    if (!make_dir(dir_full_path)) {
+        return nullptr;
+    }
+
+    dir_counter_t counter = {};
+    std::snprintf(counter.path, sizeof(counter.path), "%s", dir_full_path);
+
+    // Files from before sharding may still lie directly in the base directory
+    int highest = scan_highest_index(dir_full_path);
+    if (highest < 0) {
+        return nullptr;
+    }
+    counter.shard = scan_highest_shard(dir_full_path);
+    if (counter.shard >= 0) {
+        char path[160];
+        shard_path(counter.path, counter.shard, path, sizeof(path));
+        highest = std::max(highest, scan_highest_index(path));
+    }
+    counter.next_index = highest + 1;
+    ESP_LOGI(TAG, "Recovered file index %d for %s", highest, dir_full_path);
+
+    m_counters[m_num_counters] = counter;
+    return &m_counters[m_num_counters++];
+}
+
+bool FileNamer::next_file_path(const char *dir_full_path, char *filepath, size_t filepath_len)
+{
+    dir_counter_t *counter = get_counter(dir_full_path);
+    if (!counter) {
+        return false;
+    }
+
+    const int idx = counter->next_index;
+    const int shard = (idx - 1) / m_files_per_dir;
+    char dir[160];
+    shard_path(counter->path, shard, dir, sizeof(dir));
+    if (shard != counter->shard) {
+        if (!make_dir(dir)) {
+            return false;
+        }
+        counter->shard = shard;
+    }
+
+    std::snprintf(filepath, filepath_len, "%s/%s%06d%s", dir, m_prefix, idx, m_extension);
+    counter->next_index++;
+    return true;
+}
+
+// --------- Public API ----------------------------------
+
+bool make_dir(const char *full_path) {
+    struct stat st;
+    if (stat(full_path, &st) == 0) {
+        if (S_ISDIR(st.st_mode)) {
+            ESP_LOGD(TAG, "Dir already exists: %s", full_path);
+            return true;
+        }
+        ESP_LOGE(TAG, "Path exists but is not a directory: %s", full_path);
+        return false;
+    }
+
+    if (mkdir(full_path, 0775) != 0) {
+        ESP_LOGE(TAG, "mkdir failed for %s (errno=%d)", full_path, errno);
+        return false;
+    }
+    ESP_LOGI(TAG, "Created dir: %s", full_path);
+    return true;
+}
+
+} // namespace naming
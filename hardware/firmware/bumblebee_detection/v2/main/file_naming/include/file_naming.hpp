@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stddef.h>
+
+namespace naming {
+
+// Create full_path unless it already exists as a directory
+bool make_dir(const char *full_path);
+
+// Hands out <dir>/<shard>/<prefix><index><extension> names, e.g.
+// /sdcard/bumblebee_tracking/0000/bumblebee_000001.jpg.
+// The next index per output directory is recovered by a single directory scan on
+// first use and only incremented in memory afterwards, so a save does not depend on
+// the number of files already on the card.
+// Files are sharded into numbered subdirectories of files_per_dir files each
+// because FATFS lookups are linear in the directory size.
+// Plain POSIX, so the same code runs on the SD card and on the host.
+class FileNamer {
+public:
+    static constexpr int MAX_DIRS = 4;
+
+    FileNamer(int files_per_dir, const char *prefix = "bumblebee_", const char *extension = ".jpg");
+
+    // Full path for the next file below dir_full_path, creating the shard directory on demand
+    bool next_file_path(const char *dir_full_path, char *filepath, size_t filepath_len);
+
+private:
+    struct dir_counter_t {
+        char path[128];
+        int next_index;
+        int shard; // shard directory known to exist, -1 if none yet
+    };
+
+    int scan_highest_index(const char *path) const;
+    dir_counter_t *get_counter(const char *dir_full_path);
+
+    int m_files_per_dir;
+    const char *m_prefix;
+    const char *m_extension;
+    dir_counter_t m_counters[MAX_DIRS];
+    int m_num_counters;
+};
+
+} // namespace naming
@@ -0,0 +1,215 @@
+#include "frame_convert.hpp"
+
+#include <string.h>
+
+#include "sdkconfig.h"
+
+#if CONFIG_BEESENSE_FAST_KERNELS && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "The word kernels assume a little-endian CPU"
+#endif
+
+namespace frame {
+
+// --------- Pixel helpers ----------------------------------
+
+// Big-endian RGB565 bytes to 0x00BBGGRR, i.e. R, G, B in memory order
+static inline uint32_t rgb565_to_rgb888(uint32_t hi, uint32_t lo) {
+    return (hi & 0xF8) | ((((hi << 5) | (lo >> 3)) & 0xFC) << 8) | (((lo << 3) & 0xF8) << 16);
+}
+
+// RGB888 to big-endian RGB565, as a little-endian halfword (first byte in the low bits)
+static inline uint32_t rgb888_to_rgb565be(uint32_t r, uint32_t g, uint32_t b) {
+    const uint32_t hi = (r & 0xF8) | (g >> 5);
+    const uint32_t lo = ((g << 3) & 0xE0) | (b >> 3);
+    return hi | (lo << 8);
+}
+
+#if CONFIG_BEESENSE_FAST_KERNELS
+// 16.16 step of an exact 2:1 downscale, which reads whole source words
+static constexpr uint32_t STEP_HALF = 2u << 16;
+
+static inline bool aligned4(const void *p) {
+    return ((uintptr_t)p & 3) == 0;
+}
+
+// Four RGB888 pixels (0x00BBGGRR) into three words
+static inline void store4_rgb888(uint32_t *d, uint32_t p0, uint32_t p1, uint32_t p2, uint32_t p3) {
+    d[0] = p0 | (p1 << 24);
+    d[1] = (p1 >> 8) | (p2 << 16);
+    d[2] = (p2 >> 16) | (p3 << 8);
+}
+#endif
+
+// --------- Row kernels ----------------------------------
+// The scalar loop at the end of each kernel is the reference implementation and
+// also handles the tail and unaligned rows of the word version.
+
+static void row_rgb565_to_rgb888(const uint8_t *s, uint8_t *d, int n) {
+#if CONFIG_BEESENSE_FAST_KERNELS
+    if (aligned4(s) && aligned4(d)) {
+        const uint32_t *s32 = reinterpret_cast<const uint32_t *>(s);
+        uint32_t *d32 = reinterpret_cast<uint32_t *>(d);
+        for (; n >= 4; n -= 4, s32 += 2, d32 += 3) {
+            const uint32_t a = s32[0];
+            const uint32_t b = s32[1];
+            store4_rgb888(d32, rgb565_to_rgb888(a & 0xFF, (a >> 8) & 0xFF),
+                          rgb565_to_rgb888((a >> 16) & 0xFF, a >> 24),
+                          rgb565_to_rgb888(b & 0xFF, (b >> 8) & 0xFF),
+                          rgb565_to_rgb888((b >> 16) & 0xFF, b >> 24));
+        }
+        s = reinterpret_cast<const uint8_t *>(s32);
+        d = reinterpret_cast<uint8_t *>(d32);
+    }
+#endif
+    for (; n > 0; --n, s += 2, d += 3) {
+        // Camera delivers the high byte first
+        uint16_t pixel = (uint16_t)((s[0] << 8) | s[1]);
+        d[0] = (uint8_t)((pixel >> 8) & 0xF8); // R
+        d[1] = (uint8_t)((pixel >> 3) & 0xFC); // G
+        d[2] = (uint8_t)((pixel << 3) & 0xF8); // B
+    }
+}
+
+// Nearest neighbour: pixel x of the row is src pixel (fx + x * step) >> 16
+static void row_resize_rgb565(const uint8_t *row, uint32_t step, uint8_t *d, int n) {
+    uint32_t fx = 0;
+#if CONFIG_BEESENSE_FAST_KERNELS
+    if (step == STEP_HALF && aligned4(row) && aligned4(d)) {
+        // Every second pixel: the low halfword of each source word
+        const uint32_t *s32 = reinterpret_cast<const uint32_t *>(row);
+        uint32_t *d32 = reinterpret_cast<uint32_t *>(d);
+        for (; n >= 2; n -= 2, s32 += 2, fx += 2 * step) {
+            *d32++ = (s32[0] & 0xFFFF) | (s32[1] << 16);
+        }
+        d = reinterpret_cast<uint8_t *>(d32);
+    } else if (((uintptr_t)row & 1) == 0 && aligned4(d)) {
+        const uint16_t *s16 = reinterpret_cast<const uint16_t *>(row);
+        uint32_t *d32 = reinterpret_cast<uint32_t *>(d);
+        for (; n >= 2; n -= 2, fx += 2 * step) {
+            *d32++ = s16[fx >> 16] | (uint32_t(s16[(fx + step) >> 16]) << 16);
+        }
+        d = reinterpret_cast<uint8_t *>(d32);
+    }
+#endif
+    for (; n > 0; --n, fx += step, d += 2) {
+        const uint8_t *s = row + (fx >> 16) * 2;
+        d[0] = s[0];
+        d[1] = s[1];
+    }
+}
+
+static void row_resize_rgb565_to_rgb888(const uint8_t *row, uint32_t step, uint8_t *d, int n) {
+    uint32_t fx = 0;
+#if CONFIG_BEESENSE_FAST_KERNELS
+    if (step == STEP_HALF && aligned4(row) && aligned4(d)) {
+        // Every second pixel, four source words for four output pixels
+        const uint32_t *s32 = reinterpret_cast<const uint32_t *>(row);
+        uint32_t *d32 = reinterpret_cast<uint32_t *>(d);
+        for (; n >= 4; n -= 4, s32 += 4, d32 += 3, fx += 4 * step) {
+            store4_rgb888(d32, rgb565_to_rgb888(s32[0] & 0xFF, (s32[0] >> 8) & 0xFF),
+                          rgb565_to_rgb888(s32[1] & 0xFF, (s32[1] >> 8) & 0xFF),
+                          rgb565_to_rgb888(s32[2] & 0xFF, (s32[2] >> 8) & 0xFF),
+                          rgb565_to_rgb888(s32[3] & 0xFF, (s32[3] >> 8) & 0xFF));
+        }
+        d = reinterpret_cast<uint8_t *>(d32);
+    } else if (aligned4(d)) {
+        uint32_t *d32 = reinterpret_cast<uint32_t *>(d);
+        for (; n >= 4; n -= 4, d32 += 3) {
+            uint32_t p[4];
+            for (int i = 0; i < 4; ++i, fx += step) {
+                const uint8_t *s = row + (fx >> 16) * 2;
+                p[i] = rgb565_to_rgb888(s[0], s[1]);
+            }
+            store4_rgb888(d32, p[0], p[1], p[2], p[3]);
+        }
+        d = reinterpret_cast<uint8_t *>(d32);
+    }
+#endif
+    for (; n > 0; --n, fx += step, d += 3) {
+        const uint8_t *s = row + (fx >> 16) * 2;
+        uint16_t pixel = (uint16_t)((s[0] << 8) | s[1]);
+        d[0] = (uint8_t)((pixel >> 8) & 0xF8); // R
+        d[1] = (uint8_t)((pixel >> 3) & 0xFC); // G
+        d[2] = (uint8_t)((pixel << 3) & 0xF8); // B
+    }
+}
+
+// --------- Public API ----------------------------------
+
+void crop_rgb565_to_rgb888(const uint8_t *src, int src_width,
+                           int x0, int y0, int width, int height,
+                           uint8_t *dst) {
+#if CONFIG_BEESENSE_P4_HW_IMAGE
+    if (ppa::to_rgb888(src, src_width, x0, y0, width, height, dst, width, height)) {
+        return;
+    }
+#endif
+    for (int y = 0; y < height; ++y) {
+        row_rgb565_to_rgb888(src + ((y0 + y) * src_width + x0) * 2, dst + y * width * 3, width);
+    }
+}
+
+void crop_rgb565(const uint8_t *src, int src_width,
+                 int x0, int y0, int width, int height,
+                 uint8_t *dst) {
+    const int row_bytes = width * 2;
+    for (int y = 0; y < height; ++y) {
+        memcpy(dst + y * row_bytes, src + ((y0 + y) * src_width + x0) * 2, row_bytes);
+    }
+}
+
+void resize_rgb565(const uint8_t *src, int src_width,
+                   int x0, int y0, int src_w, int src_h,
+                   uint8_t *dst, int dst_width, int dst_height) {
+    const uint32_t step_x = ((uint32_t)src_w << 16) / dst_width;
+    const uint32_t step_y = ((uint32_t)src_h << 16) / dst_height;
+    uint32_t fy = 0;
+    for (int y = 0; y < dst_height; ++y, fy += step_y) {
+        const uint8_t *row = src + ((y0 + (fy >> 16)) * src_width + x0) * 2;
+        row_resize_rgb565(row, step_x, dst + y * dst_width * 2, dst_width);
+    }
+}
+
+void resize_rgb565_to_rgb888(const uint8_t *src, int src_width,
+                             int x0, int y0, int src_w, int src_h,
+                             uint8_t *dst, int dst_width, int dst_height) {
+#if CONFIG_BEESENSE_P4_HW_IMAGE
+    if (ppa::to_rgb888(src, src_width, x0, y0, src_w, src_h, dst, dst_width, dst_height)) {
+        return;
+    }
+#endif
+    const uint32_t step_x = ((uint32_t)src_w << 16) / dst_width;
+    const uint32_t step_y = ((uint32_t)src_h << 16) / dst_height;
+    uint32_t fy = 0;
+    for (int y = 0; y < dst_height; ++y, fy += step_y) {
+        const uint8_t *row = src + ((y0 + (fy >> 16)) * src_width + x0) * 2;
+        row_resize_rgb565_to_rgb888(row, step_x, dst + y * dst_width * 3, dst_width);
+    }
+}
+
+void rgb888_to_rgb565(const uint8_t *src, int num_pixels, uint8_t *dst) {
+    int n = num_pixels;
+#if CONFIG_BEESENSE_FAST_KERNELS
+    if (aligned4(src) && aligned4(dst)) {
+        const uint32_t *s32 = reinterpret_cast<const uint32_t *>(src);
+        uint32_t *d32 = reinterpret_cast<uint32_t *>(dst);
+        // r0 g0 b0 r1 | g1 b1 r2 g2 | b2 r3 g3 b3
+        for (; n >= 4; n -= 4, s32 += 3, d32 += 2) {
+            const uint32_t a = s32[0], b = s32[1], c = s32[2];
+            d32[0] = rgb888_to_rgb565be(a & 0xFF, (a >> 8) & 0xFF, (a >> 16) & 0xFF) |
+                     (rgb888_to_rgb565be(a >> 24, b & 0xFF, (b >> 8) & 0xFF) << 16);
+            d32[1] = rgb888_to_rgb565be((b >> 16) & 0xFF, b >> 24, c & 0xFF) |
+                     (rgb888_to_rgb565be((c >> 8) & 0xFF, (c >> 16) & 0xFF, c >> 24) << 16);
+        }
+        src = reinterpret_cast<const uint8_t *>(s32);
+        dst = reinterpret_cast<uint8_t *>(d32);
+    }
+#endif
+    for (; n > 0; --n, src += 3, dst += 2) {
+        const uint32_t v = rgb888_to_rgb565be(src[0], src[1], src[2]);
+        dst[0] = (uint8_t)(v & 0xFF);
+        dst[1] = (uint8_t)(v >> 8);
+    }
+}
+
+} // namespace frame
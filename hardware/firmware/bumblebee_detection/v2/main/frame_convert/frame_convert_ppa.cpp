@@ -0,0 +1,137 @@
+#include "frame_convert.hpp"
+
+#include "sdkconfig.h"
+
+#if CONFIG_BEESENSE_P4_HW_IMAGE
+
+#include <mutex>
+
+#include "driver/ppa.h"
+#include "esp_log.h"
+
+namespace frame {
+namespace ppa {
+
+static const char *TAG = "PPA";
+
+// Tasks that convert frames: the capture task crops the camera frame, the storage
+// task expands an RGB565 model input to RGB888 for drawing and saving and swaps
+// red and blue for the JPEG codec
+static constexpr int NUM_CONVERTING_TASKS = 2;
+
+// One scale-rotate-mirror client shared by both tasks, registered once on first use.
+// The driver queues the transactions of a client, so only the registration needs a guard.
+static std::once_flag g_register_once;
+static ppa_client_handle_t g_client = nullptr;
+
+// --------- Internal helpers ----------------------------------
+
+static void register_client() {
+    ppa_client_config_t cfg = {};
+    cfg.oper_type = PPA_OPERATION_SRM;
+    cfg.max_pending_trans_num = NUM_CONVERTING_TASKS; // one blocking job per task
+    esp_err_t err = ppa_register_client(&cfg, &g_client);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Registering the SRM client failed (%s), using the software kernels", esp_err_to_name(err));
+        g_client = nullptr;
+    }
+}
+
+// The SRM scales in steps of 1/16. Other factors would leave the output block smaller
+// than the destination, so those jobs stay with the software kernels.
+static bool exact_scale(int src, int dst) {
+    return (dst * 16) % src == 0;
+}
+
+static ppa_client_handle_t client() {
+    std::call_once(g_register_once, register_client);
+    return g_client;
+}
+
+// --------- Public API ----------------------------------
+
+bool to_rgb888(const uint8_t *src, int src_width, int x0, int y0, int src_w, int src_h,
+               uint8_t *dst, int dst_width, int dst_height) {
+    // The driver invalidates the output range after the DMA, it must not share cache lines
+    const size_t out_bytes = size_t(dst_width) * dst_height * 3;
+    if ((uintptr_t)dst % BUFFER_ALIGN != 0 || out_bytes % BUFFER_ALIGN != 0) {
+        return false;
+    }
+    if (!exact_scale(src_w, dst_width) || !exact_scale(src_h, dst_height)) {
+        return false;
+    }
+    ppa_client_handle_t handle = client();
+    if (handle == nullptr) {
+        return false;
+    }
+
+    ppa_srm_oper_config_t op = {};
+    op.in.buffer = src;
+    op.in.pic_w = src_width;
+    op.in.pic_h = y0 + src_h; // rows below the block are never read
+    op.in.block_w = src_w;
+    op.in.block_h = src_h;
+    op.in.block_offset_x = x0;
+    op.in.block_offset_y = y0;
+    op.in.srm_cm = PPA_SRM_COLOR_MODE_RGB565;
+    op.out.buffer = dst;
+    op.out.buffer_size = out_bytes;
+    op.out.pic_w = dst_width;
+    op.out.pic_h = dst_height;
+    op.out.srm_cm = PPA_SRM_COLOR_MODE_RGB888;
+    op.rotation_angle = PPA_SRM_ROTATION_ANGLE_0;
+    op.scale_x = float(dst_width) / src_w;
+    op.scale_y = float(dst_height) / src_h;
+    op.byte_swap = true; // camera RGB565 comes high byte first
+    op.rgb_swap = true;  // R, G, B in memory order like the software kernels
+    op.mode = PPA_TRANS_MODE_BLOCKING;
+
+    esp_err_t err = ppa_do_scale_rotate_mirror(handle, &op);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "SRM %dx%d -> %dx%d failed (%s), using the software kernels",
+                 src_w, src_h, dst_width, dst_height, esp_err_to_name(err));
+        return false;
+    }
+    return true;
+}
+
+bool to_bgr888(const uint8_t *src, int width, int height, uint8_t *dst, size_t dst_size) {
+    const size_t out_bytes = size_t(width) * height * 3;
+    if ((uintptr_t)dst % BUFFER_ALIGN != 0 || dst_size % BUFFER_ALIGN != 0 || dst_size < out_bytes) {
+        return false;
+    }
+    ppa_client_handle_t handle = client();
+    if (handle == nullptr) {
+        return false;
+    }
+
+    ppa_srm_oper_config_t op = {};
+    op.in.buffer = src;
+    op.in.pic_w = width;
+    op.in.pic_h = height;
+    op.in.block_w = width;
+    op.in.block_h = height;
+    op.in.srm_cm = PPA_SRM_COLOR_MODE_RGB888;
+    op.out.buffer = dst;
+    op.out.buffer_size = dst_size;
+    op.out.pic_w = width;
+    op.out.pic_h = height;
+    op.out.srm_cm = PPA_SRM_COLOR_MODE_RGB888;
+    op.rotation_angle = PPA_SRM_ROTATION_ANGLE_0;
+    op.scale_x = 1.0f;
+    op.scale_y = 1.0f;
+    op.rgb_swap = true; // the only change: R, G, B -> B, G, R
+    op.mode = PPA_TRANS_MODE_BLOCKING;
+
+    esp_err_t err = ppa_do_scale_rotate_mirror(handle, &op);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "SRM red/blue swap of %dx%d failed (%s)", width, height, esp_err_to_name(err));
+        return false;
+    }
+    return true;
+}
+
+} // namespace ppa
+} // namespace frame
+
+#endif // CONFIG_BEESENSE_P4_HW_IMAGE
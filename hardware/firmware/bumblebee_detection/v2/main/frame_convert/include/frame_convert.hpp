@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sdkconfig.h"
+
+namespace frame {
+
+// Alignment of image buffers. The P4 PPA writes whole cache lines back, so with the
+// hardware path its output buffers must start and end on an L2 cache line.
+#if CONFIG_BEESENSE_P4_HW_IMAGE
+static constexpr size_t BUFFER_ALIGN = CONFIG_CACHE_L2_CACHE_LINE_SIZE;
+#else
+static constexpr size_t BUFFER_ALIGN = 16;
+#endif
+
+// Convert the width x height window at (x0, y0) of a big-endian RGB565 frame
+// (as delivered by the camera) directly into a packed RGB888 buffer.
+// Pixel values are identical to dl::image::RGB5652RGB888<true, false>.
+// dst must hold width * height * 3 bytes.
+void crop_rgb565_to_rgb888(const uint8_t *src, int src_width,
+                           int x0, int y0, int width, int height,
+                           uint8_t *dst);
+
+// Copy the width x height window at (x0, y0) of an RGB565 frame without converting it.
+// The byte order is kept, so a big-endian camera frame stays big-endian.
+// dst must hold width * height * 2 bytes.
+void crop_rgb565(const uint8_t *src, int src_width,
+                 int x0, int y0, int width, int height,
+                 uint8_t *dst);
+
+// Nearest-neighbour scale the src_w x src_h window at (x0, y0) of a big-endian RGB565
+// frame to dst_width x dst_height. Source coordinates are stepped in 16.16 fixed point.
+void resize_rgb565(const uint8_t *src, int src_width,
+                   int x0, int y0, int src_w, int src_h,
+                   uint8_t *dst, int dst_width, int dst_height);
+
+// As resize_rgb565, but writes packed RGB888 like crop_rgb565_to_rgb888.
+void resize_rgb565_to_rgb888(const uint8_t *src, int src_width,
+                             int x0, int y0, int src_w, int src_h,
+                             uint8_t *dst, int dst_width, int dst_height);
+
+// Pack num_pixels RGB888 pixels into big-endian RGB565, the inverse of crop_rgb565_to_rgb888
+// for values it produced.
+void rgb888_to_rgb565(const uint8_t *src, int num_pixels, uint8_t *dst);
+
+// The kernels above come in a scalar reference version and, with CONFIG_BEESENSE_FAST_KERNELS,
+// a version that moves 32-bit words instead of single bytes. Both give bit-identical results;
+// the word version falls back to the scalar one for rows that are not 4-byte aligned.
+// An exact 2:1 downscale (src_w == 2 * dst_width) has its own word path in both resizes.
+// With CONFIG_BEESENSE_P4_HW_IMAGE the conversions to RGB888 run on the P4's PPA instead
+// (scaled output is then filtered by the PPA, not nearest neighbour) and fall back to the
+// kernels for jobs the PPA cannot take.
+
+#if CONFIG_BEESENSE_P4_HW_IMAGE
+// frame_convert_ppa.cpp. Each returns false if the PPA cannot do the job.
+namespace ppa {
+// Scale/crop a big-endian RGB565 window to RGB888 (R, G, B in memory order)
+bool to_rgb888(const uint8_t *src, int src_width, int x0, int y0, int src_w, int src_h,
+               uint8_t *dst, int dst_width, int dst_height);
+
+// Copy a width x height RGB888 image with red and blue exchanged, R, G, B -> B, G, R.
+// dst must be BUFFER_ALIGN aligned, dst_size its size (a multiple of BUFFER_ALIGN).
+bool to_bgr888(const uint8_t *src, int width, int height, uint8_t *dst, size_t dst_size);
+}
+#endif
+
+// Window inside a camera frame, in sensor pixels
+struct rect_t {
+    int x, y, w, h;
+};
+
+// Move rect inside a frame_width x frame_height frame, keeping its size
+inline void clamp_rect(rect_t &rect, int frame_width, int frame_height) {
+    if (rect.x + rect.w > frame_width) rect.x = frame_width - rect.w;
+    if (rect.y + rect.h > frame_height) rect.y = frame_height - rect.h;
+    if (rect.x < 0) rect.x = 0;
+    if (rect.y < 0) rect.y = 0;
+}
+
+// Top-left corner of a centered size x size window inside a src_width x src_height frame.
+inline void center_crop_origin(int src_width, int src_height, int size, int &x0, int &y0) {
+    x0 = (src_width - size) / 2;
+    y0 = (src_height - size) / 2;
+}
+
+} // namespace frame
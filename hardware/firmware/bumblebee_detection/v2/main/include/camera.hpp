@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "esp_camera.h"
+#include "frame_convert.hpp"
+
+namespace camera {
+
+struct config_t {
+    int fb_count;          // frame buffers in PSRAM, 2+ lets the driver capture continuously
+    bool grab_latest;      // CAMERA_GRAB_LATEST: grab() returns the newest frame, stale ones are overwritten
+    bool sensor_window;    // let the sensor send only a window around roi instead of the full frame
+    frame::rect_t roi;     // ROI in full-frame camera coordinates, used to place the sensor window
+};
+
+struct stats_t {
+    uint32_t frames;       // frames handed out by grab()
+    uint32_t failed;
+    int64_t age_us_sum;    // time between end of exposure readout and grab(), summed
+    int64_t age_us_max;
+    uint32_t power_downs;
+};
+
+// Initialise the sensor. With sensor_window set and an OV2640 on the bus, the sensor
+// is windowed to FRAMESIZE_240X240 around the ROI at the QVGA pixel scale, so camera
+// coordinates stay the same, only fewer pixels cross DMA and PSRAM.
+// Other sensors or an ROI that does not fit fall back to the full QVGA frame.
+bool init(const config_t &cfg);
+
+// Next frame from the driver, nullptr on failure. Hand it back with release().
+camera_fb_t *grab();
+void release(camera_fb_t *fb);
+
+// Switch the sensor into power-down over its PWDN pin and back. While the camera is
+// on, a power management lock keeps the system out of automatic light sleep, which
+// would stall the camera DMA. After power-up the frames from before are dropped, and
+// settle_frames more while the sensor's auto exposure and white balance converge.
+// Returns false if the board has no PWDN pin.
+bool set_power(bool on, int settle_frames = 0);
+
+// Part of the full camera frame the frame buffers contain, (0, 0, width, height) without a sensor window
+frame::rect_t window();
+
+stats_t get_stats();
+
+} // namespace camera
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <list>
+
+#include "dl_image_define.hpp"
+#include "dl_detect_define.hpp"
+
+namespace detector {
+
+// Input edge length of espdet_pico_96_96_bumblebee
+static constexpr int SMALL_IMG_SIZE = 96;
+
+// Which model run() uses
+enum mode_t {
+    MODE_224,      // espdet_pico_224_224_bumblebee on every frame
+    MODE_96,       // espdet_pico_96_96_bumblebee on every frame
+    MODE_ADAPTIVE, // 96x96 first, 224x224 only if it finds something or tracks are active
+};
+
+// What run() returns: results above score_thr whose category is set in class_mask.
+// Applied inside the postprocessor, filtered anchors are neither decoded nor part of NMS.
+struct filter_t {
+    float score_thr;
+    uint32_t class_mask; // bit c keeps category c
+};
+
+struct stats_t {
+    uint32_t runs_224;
+    uint32_t runs_96;
+    uint32_t escalations; // adaptive: 96x96 runs that were followed by a 224x224 run
+    uint32_t gated;       // model runs without any score above the threshold, postprocessor skipped
+};
+
+// Load the models needed for mode and run a warm-up inference on the embedded sample image.
+// escalate_score: adaptive mode runs the 224x224 model if the 96x96 model finds a result above this
+// score, its postprocessor uses it instead of filter.score_thr.
+// nms_thr: postprocessor NMS threshold of both models, negative keeps the ESPDet default.
+bool init(mode_t mode, const filter_t &filter, float escalate_score = 0.25f, float nms_thr = -1.0f);
+
+// Change the filter at runtime, takes effect with the next run().
+void set_filter(const filter_t &filter);
+filter_t get_filter();
+
+// Replace the loaded models, e.g. after a new .espdl was flashed or copied to the SD card.
+bool reload();
+
+// Switch the mode at runtime, missing models are loaded on the spot.
+bool set_mode(mode_t mode);
+mode_t get_mode();
+
+bool is_loaded();
+
+// Run the model(s) on img. In adaptive mode tracks_active skips the 96x96 pre-check.
+// small_img is the same window at SMALL_IMG_SIZE and goes to the 96x96 model, without it
+// esp-dl scales img down. Results always refer to img. Returns nullptr if no model is loaded.
+std::list<dl::detect::result_t> *run(const dl::image::img_t &img, bool tracks_active = false,
+                                     const dl::image::img_t *small_img = nullptr);
+
+// Timings of the last model load and the last call to run() (both models in adaptive mode).
+int64_t load_time_us();
+int64_t last_inference_us();
+
+stats_t get_stats();
+
+} // namespace detector
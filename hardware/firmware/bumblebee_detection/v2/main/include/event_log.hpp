@@ -0,0 +1,133 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+namespace eventlog {
+
+// File format (little endian), decoded by host/decode_events.py:
+// the file is a sequence of BLOCK_SIZE byte blocks, block n at offset n * BLOCK_SIZE.
+// Every block starts with a block_header_t, followed by up to RECORDS_PER_BLOCK records.
+// The CRC-32 covers the whole block with the crc field set to 0, a block with a
+// wrong CRC is a torn write and is skipped by the decoder.
+static constexpr int BLOCK_SIZE = 512;
+static constexpr uint32_t MAGIC = 0x56455342; // "BSEV"
+static constexpr uint16_t VERSION = 1;
+
+enum record_type_t : uint8_t {
+    REC_SESSION = 1,   // log opened, wall clock at time_ms
+    REC_DETECTION = 2, // one box in camera coordinates
+    REC_CROSSING = 3,  // a track crossed a counting zone
+};
+
+struct __attribute__((packed)) block_header_t {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t num_records;
+    uint32_t seq; // block index in the file
+    uint32_t crc;
+};
+
+struct __attribute__((packed)) session_t {
+    uint32_t unix_time; // 0 if the RTC is not set
+    uint32_t reserved[2];
+};
+
+struct __attribute__((packed)) box_t {
+    int16_t x1, y1, x2, y2;
+    uint16_t score; // score * 65535
+    uint16_t reserved;
+};
+
+struct __attribute__((packed)) totals_t {
+    int32_t einflug; // counts of the zone after the frame of this crossing
+    int32_t ausflug;
+    uint16_t zone;   // index of the zone in counting::ZoneCounter
+    uint16_t reserved;
+};
+
+struct __attribute__((packed)) record_t {
+    uint32_t time_ms;  // ms since boot
+    uint32_t frame_id;
+    uint8_t type;      // record_type_t
+    uint8_t direction; // REC_CROSSING: counting::direction_t
+    uint16_t track_id; // 0 = no track
+    union {
+        session_t session;   // REC_SESSION
+        box_t detection;     // REC_DETECTION
+        totals_t crossing;   // REC_CROSSING
+    };
+};
+
+static_assert(sizeof(block_header_t) == 16, "block header layout");
+static_assert(sizeof(record_t) == 24, "record layout");
+
+static constexpr int RECORDS_PER_BLOCK = (BLOCK_SIZE - sizeof(block_header_t)) / sizeof(record_t);
+
+struct __attribute__((packed)) block_t {
+    block_header_t header;
+    record_t records[RECORDS_PER_BLOCK];
+    uint8_t padding[BLOCK_SIZE - sizeof(block_header_t) - RECORDS_PER_BLOCK * sizeof(record_t)];
+};
+
+static_assert(sizeof(block_t) == BLOCK_SIZE, "block layout");
+
+struct stats_t {
+    uint32_t records;
+    uint32_t blocks;  // completed blocks
+    uint32_t syncs;
+    uint32_t errors;  // failed writes
+    uint32_t lost;    // full blocks dropped because an earlier one still waited for its retry
+};
+
+uint32_t crc32(const uint8_t *data, size_t len, uint32_t crc = 0);
+
+// Append-only binary log of detections and crossings.
+// Records are collected in one block in RAM. A full block is written at its own
+// sector-aligned offset. Every sync_interval_ms the partial block is written in
+// place as well and the file is fsync'ed, so a power loss costs at most that much.
+// A full block whose write fails is kept and written again on the next sync; one
+// such block is kept, further failed blocks are counted as lost.
+// No allocations after open(). Not thread-safe, use it from one task.
+// Plain POSIX, so the replay driver on the host writes the same format.
+class EventLog {
+public:
+    explicit EventLog(uint32_t sync_interval_ms);
+    ~EventLog();
+
+    // Continue the log at path after its last whole block, or create it
+    bool open(const char *path, uint32_t time_ms, uint32_t unix_time);
+    void close();
+    bool is_open() const { return m_file != nullptr; }
+
+    void detection(uint32_t time_ms, uint32_t frame_id, uint32_t track_id, int x1, int y1, int x2, int y2, float score);
+    void crossing(uint32_t time_ms, uint32_t frame_id, uint32_t track_id, int zone, int direction, int einflug,
+                  int ausflug);
+
+    // Sync if the interval has passed, call once per frame
+    void tick(uint32_t time_ms);
+
+    // Write the partial block and fsync
+    bool sync(uint32_t time_ms);
+
+    const stats_t &stats() const { return m_stats; }
+
+private:
+    void append(const record_t &rec);
+    bool write_block(block_t &block, uint32_t index);
+    bool write_pending();
+
+    uint32_t m_sync_interval_ms;
+    FILE *m_file;
+    uint32_t m_block_index;
+    uint32_t m_last_sync_ms;
+    bool m_dirty;
+    bool m_has_pending;
+    uint32_t m_pending_index;
+    block_t m_block;
+    block_t m_pending; // full block whose write failed
+    stats_t m_stats;
+};
+
+} // namespace eventlog
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace frame_pool {
+
+// One PSRAM block reserved at boot and carved into aligned frame buffers.
+// Buffers are handed out once and stay with their pipeline slot for the lifetime
+// of the program, slots circulate through the pipeline queues instead of being
+// freed, so the steady-state loop does not touch the heap.
+bool reserve(size_t bytes);
+
+// Aligned buffer from the reserved block, nullptr if it is exhausted.
+// The default alignment suits esp-dl's SIMD loads.
+void *take(size_t bytes, size_t align = 16);
+
+size_t used();
+size_t capacity();
+
+// Count the heap allocations of the calling task into counter (CONFIG_BEESENSE_ALLOC_COUNTER).
+// Without the option this does nothing and counter stays 0.
+void count_allocations(uint32_t *counter);
+
+} // namespace frame_pool
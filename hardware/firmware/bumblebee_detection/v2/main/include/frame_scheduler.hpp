@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace scheduler {
+
+enum mode_t {
+    MODE_ACTIVE, // motion, detections or tracks recently: sample fast
+    MODE_QUIET,  // nothing happened for a while: long interval, camera off
+    MODE_NIGHT,  // night hours without activity: longest interval, camera off
+    MODE_COUNT,
+};
+
+const char *mode_name(mode_t mode);
+
+struct config_t {
+    uint32_t active_interval_ms; // between frames while active, 0 = as fast as the pipeline runs
+    uint32_t quiet_after_ms;     // no activity for this long switches to quiet
+    uint32_t quiet_interval_ms;
+    int night_start_hour;        // local time, equal start and end disable night mode
+    int night_end_hour;
+    uint32_t night_interval_ms;
+    uint32_t power_down_min_ms;  // power the camera down for waits at least this long
+};
+
+// Wait before the next capture
+struct plan_t {
+    mode_t mode;
+    uint32_t delay_ms;
+    bool power_down; // camera off during the wait, the system may light-sleep
+};
+
+struct stats_t {
+    uint32_t frames[MODE_COUNT];
+    uint64_t mode_ms[MODE_COUNT]; // time spent in each mode
+    uint64_t wait_ms[MODE_COUNT]; // part of it spent waiting between frames
+    uint32_t power_downs;
+    uint32_t switches;
+};
+
+// Picks the interval to the next frame from recent activity and the time of day.
+// Time comes in as ms from any monotonic clock (wrapping uint32 is fine), so the
+// same code runs with esp_timer on the device and a simulated clock on the host.
+// Activity takes precedence over night, a bumblebee at dusk is still counted.
+class Scheduler {
+public:
+    explicit Scheduler(const config_t &cfg);
+
+    // Call once before each capture. last_activity_ms is the time of the last frame
+    // with motion, detections or tracks; hour is the local hour or -1 if the clock is not set.
+    plan_t next(uint32_t now_ms, uint32_t last_activity_ms, int hour);
+
+    mode_t mode() const { return m_mode; }
+    const stats_t &stats() const { return m_stats; }
+
+    // Awake share of the time in mode, 1.0 before anything was recorded
+    float duty_cycle(mode_t mode) const;
+
+private:
+    bool is_night(int hour) const;
+
+    config_t m_cfg;
+    mode_t m_mode;
+    bool m_started;
+    uint32_t m_last_ms;
+    stats_t m_stats;
+};
+
+} // namespace scheduler
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace motion {
+
+// Largest image handled, in cells of the smallest block size
+static constexpr int MAX_GRID_CELLS = (224 / 4) * (224 / 4);
+
+struct config_t {
+    int block_size;        // cell edge length in pixels, 4..32
+    int cell_threshold;    // mean luminance change (0..255) for a cell to count as changed
+    int min_changed_cells; // changed cells needed to report motion
+    int background_shift;  // background adapts by 1/2^shift of the difference per frame
+    int force_interval;    // report motion at least every N frames, 0 = never forced
+};
+
+struct stats_t {
+    uint32_t frames;
+    uint32_t motion;
+    uint32_t forced;
+};
+
+// Cheap pre-filter in front of the detector. Each frame is reduced to a grid of
+// mean-luminance cells (integer math only) and compared with a running background.
+class MotionGate {
+public:
+    explicit MotionGate(const config_t &cfg);
+
+    // Feed one frame, returns true if inference should run on it.
+    // rgb565 selects big-endian RGB565 input, otherwise packed RGB888.
+    bool update(const uint8_t *img, int width, int height, bool rgb565);
+
+    // Changed cells of the last update
+    int changed_cells() const { return m_changed_cells; }
+
+    void reset() { m_has_background = false; }
+
+    const config_t &config() const { return m_cfg; }
+    const stats_t &stats() const { return m_stats; }
+
+private:
+    void compute_cells(const uint8_t *img, int width, bool rgb565);
+
+    config_t m_cfg;
+    int m_cols, m_rows;
+    bool m_has_background;
+    int m_changed_cells;
+    int m_frames_since_inference;
+    uint8_t m_cells[MAX_GRID_CELLS];
+    uint16_t m_background[MAX_GRID_CELLS]; // luminance << 4
+    stats_t m_stats;
+};
+
+} // namespace motion
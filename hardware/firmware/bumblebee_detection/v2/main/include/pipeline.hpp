@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "dl_image_define.hpp"
+#include "frame_convert.hpp"
+
+namespace pipeline {
+
+static constexpr int MAX_DETECTIONS = 10;
+static constexpr int MAX_PRE_ROLL = 8;
+
+struct detection_t {
+    int x1, y1, x2, y2; // model_img coordinates
+    float score;
+    uint32_t track_id; // 0 = not tracked
+};
+
+// One preallocated frame slot. Slots circulate between the capture, inference and
+// storage tasks through queues; whichever task holds a slot owns it exclusively.
+struct frame_t {
+    uint32_t id;
+    int64_t timestamp_us;
+    dl::image::img_t model_img;  // model input (RGB565 or RGB888)
+    dl::image::img_t rgb888_img; // image that is drawn on and saved, may share the model_img buffer
+    dl::image::img_t small_img;  // same window at the small model's input size, data nullptr if unused
+    frame::rect_t roi;           // camera window model_img was taken from, set by the capture stage
+    bool power_cycled;           // camera was powered down before this frame, set by the capture stage
+    int num_detections;
+    detection_t detections[MAX_DETECTIONS];
+    bool save;                   // set by the inference stage, frame goes to storage if true
+    bool flush_pre_roll;         // also store the held pre-roll frames (before this one)
+};
+
+// capture: fill model_img (and small_img) from the camera, return false if no frame was taken
+// infer:   run the model on model_img, fill detections and set save / flush_pre_roll
+// store:   draw on and write rgb888_img
+typedef bool (*capture_fn_t)(frame_t &frame);
+typedef void (*process_fn_t)(frame_t &frame);
+
+struct config_t {
+    int img_size;
+    dl::image::pix_type_t model_pix_type;
+    int small_img_size; // small_img edge length (model_pix_type), 0 = no small_img
+    capture_fn_t capture;
+    process_fn_t infer;
+    process_fn_t store;
+    int pre_roll; // unsaved frames held back in extra slots, 0..MAX_PRE_ROLL
+};
+
+struct stats_t {
+    uint32_t captured;
+    uint32_t capture_failed;
+    uint32_t inferred;
+    uint32_t stored;
+    uint32_t pre_roll_stored;
+    // Heap allocations made by each task (CONFIG_BEESENSE_ALLOC_COUNTER), 0 in steady state
+    uint32_t allocs_capture;
+    uint32_t allocs_inference;
+    uint32_t allocs_storage;
+};
+
+// Allocate the frame slots and start the capture, inference and storage tasks,
+// each pinned to the core selected in menuconfig.
+bool start(const config_t &cfg);
+
+stats_t get_stats();
+
+} // namespace pipeline
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "sdkconfig.h"
+#if CONFIG_BEESENSE_PROFILER
+#include "esp_timer.h"
+#endif
+
+namespace profiler {
+
+enum stage_t {
+    STAGE_CAPTURE,     // esp_camera_fb_get
+    STAGE_CROP,        // ROI crop / scale into the model input, including color conversion
+    STAGE_MOTION,      // motion gate
+    STAGE_PREPROCESS,  // esp-dl image preprocessor
+    STAGE_MODEL,       // model forward pass
+    STAGE_POSTPROCESS, // box decoding and NMS
+    STAGE_TRACKING,    // tracker update and line counting
+    STAGE_CONVERT,     // RGB565 -> RGB888 for the saved image
+    STAGE_DRAW,        // boxes and counting line
+    STAGE_JPEG_ENCODE,
+    STAGE_SD_WRITE,
+    STAGE_COUNT,
+};
+
+const char *stage_name(stage_t stage);
+
+// Latency histogram with four buckets per power of two (1 us .. ~67 s), so
+// percentiles are exact to within 12.5 %. Fixed size, add() does not allocate.
+class Histogram {
+public:
+    static constexpr int NUM_BUCKETS = 104;
+
+    void add(uint32_t us);
+    void reset();
+
+    // Bucket midpoint below which the fraction p (0..1) of the samples lie, 0 if empty
+    uint32_t percentile(float p) const;
+
+    uint32_t count() const { return m_count; }
+    uint32_t max() const { return m_max; }
+
+private:
+    uint32_t m_buckets[NUM_BUCKETS] = {};
+    uint32_t m_count = 0;
+    uint32_t m_max = 0;
+};
+
+#if CONFIG_BEESENSE_PROFILER
+
+// Add one sample. Safe from any task, a stage may be recorded by several.
+void record(stage_t stage, int64_t us);
+
+// Count a processed frame, every CONFIG_BEESENSE_PROFILER_INTERVAL frames the
+// histograms are dumped and started anew.
+void frame_done();
+
+// Log p50/p95/p99/max per stage plus heap low-water marks and append them to the CSV on the SD card.
+// Takes the histograms and starts them anew atomically, samples recorded meanwhile go to the next dump.
+void dump();
+
+// Times its own lifetime
+class Scope {
+public:
+    explicit Scope(stage_t stage) : m_stage(stage), m_start(esp_timer_get_time()) {}
+    ~Scope() { record(m_stage, esp_timer_get_time() - m_start); }
+
+private:
+    stage_t m_stage;
+    int64_t m_start;
+};
+
+#else
+
+// Profiler disabled in menuconfig: everything compiles away
+inline void record(stage_t, int64_t) {}
+inline void frame_done() {}
+inline void dump() {}
+
+class Scope {
+public:
+    explicit Scope(stage_t) {}
+};
+
+#endif
+
+} // namespace profiler
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace save_policy {
+
+// Reasons to save a frame, can be combined
+enum mode_t : uint32_t {
+    SAVE_ALL        = 1 << 0, // every frame (old behaviour)
+    SAVE_DETECTIONS = 1 << 1, // frames with a detection at or above min_score
+    SAVE_CROSSINGS  = 1 << 2, // frames in which a line crossing was counted
+};
+
+struct config_t {
+    uint32_t modes;
+    float min_score;
+    int pre_roll;          // frames before an event that are kept in RAM and saved with it
+    int post_roll;         // frames saved after the last event frame
+    int keyframe_interval; // save at least every N-th frame, 0 = off
+};
+
+// What the inference stage knows about a frame
+struct frame_info_t {
+    int num_detections;
+    float max_score;
+    int crossings;
+};
+
+struct decision_t {
+    bool save;
+    bool event;          // frame triggered an event (detection or crossing)
+    bool flush_pre_roll; // save the frames held in RAM before this one, too
+};
+
+struct stats_t {
+    uint32_t frames;
+    uint32_t events;
+    uint32_t saved;
+    uint32_t keyframes;
+};
+
+// Decides per frame whether it goes to the SD card. Holds no frame data itself,
+// the pre-roll frames are kept by the pipeline.
+class SavePolicy {
+public:
+    explicit SavePolicy(const config_t &cfg);
+
+    decision_t evaluate(const frame_info_t &info);
+
+    const config_t &config() const { return m_cfg; }
+    const stats_t &stats() const { return m_stats; }
+
+private:
+    config_t m_cfg;
+    int m_post_roll_left;
+    int m_frames_since_save;
+    stats_t m_stats;
+};
+
+} // namespace save_policy
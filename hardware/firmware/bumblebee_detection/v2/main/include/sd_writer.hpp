@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace sdwriter {
+
+struct stats_t {
+    uint32_t queued;       // files accepted into the ring
+    uint32_t written;      // files written to the card
+    uint32_t dropped;      // files lost because the ring was full
+    uint32_t write_errors; // files that could not be written
+    size_t ring_size;
+    size_t min_free;       // lowest free ring space seen so far
+};
+
+// Allocate the PSRAM ring and start the low-priority writer task.
+bool start();
+
+bool is_running();
+
+// Copy data into the ring, the writer task writes it to path later.
+// What happens when the ring is full is selected in menuconfig
+// (drop the new file, drop the oldest queued file, or block for a while).
+// Returns false if the file was dropped.
+bool submit(const char *path, const uint8_t *data, size_t len);
+
+stats_t get_stats();
+
+} // namespace sdwriter
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace settings {
+
+static constexpr int PATH_LEN = 64;
+
+// Values that can be tuned per node without a rebuild. defaults() fills them from
+// menuconfig and the former constants, a settings file on the SD card overrides
+// single keys at boot. The keys in the file are the field names. Read-only once
+// the pipeline runs, so the tasks read the fields directly.
+struct settings_t {
+    // Detection
+    float score_thr;       // boxes at or below are dropped in the postprocessor
+    uint32_t class_mask;   // bit c keeps category c
+    float model_nms_thr;
+    float escalate_score;  // adaptive mode: 96x96 score that runs the 224x224 model
+
+    // Counting
+    int count_line_y;      // default line if there is no zone file
+    char zones_path[PATH_LEN];
+
+    // Frame scheduler
+    uint32_t active_interval_ms;
+    uint32_t quiet_after_s;
+    uint32_t quiet_interval_ms;
+    int night_start_hour;
+    int night_end_hour;
+    uint32_t night_interval_ms;
+    uint32_t power_down_min_ms;
+
+    // Storage
+    int jpeg_quality;
+    float save_min_score;
+    char image_dir[PATH_LEN]; // saved frames
+    char event_log_path[PATH_LEN];
+};
+
+settings_t defaults();
+
+// Parse "key = value" lines over s, '#' starts a comment. Unknown keys, malformed
+// lines and values out of range are logged and leave that key unchanged.
+// Returns the number of rejected lines.
+int parse(const char *text, settings_t &s);
+
+// Same for a file. Returns -1 if it cannot be opened, s is then unchanged.
+int load(const char *path, settings_t &s);
+
+// Log every key with its value, changed ones marked
+void dump(const settings_t &s);
+
+} // namespace settings
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace tracker {
+
+static constexpr int MAX_TRACKS = 16;
+static constexpr int MAX_DETECTIONS = 16;
+
+struct box_t {
+    int x1, y1, x2, y2;
+    float score;
+};
+
+struct config_t {
+    float min_iou;    // a detection and a track with at least this IoU may be matched
+    int max_distance; // ... or with the detection center at most this many pixels from the predicted center
+    int min_hits;     // matched detections before a track is confirmed
+    int max_age;      // frames a track survives without a match
+};
+
+struct track_t {
+    uint32_t id;
+    box_t box;
+    int cx, cy;           // current center
+    int prev_cx, prev_cy; // center in the previous matched frame
+    int hits;             // matched detections, including the first
+    int age;              // frames since the last match, 0 = matched in this frame
+    bool confirmed;       // hits reached min_hits once
+};
+
+struct stats_t {
+    uint32_t frames;
+    uint32_t created;
+    uint32_t confirmed;
+    uint32_t expired;
+};
+
+// Lightweight multi-object tracker. Detections are associated with tracks by
+// greedy matching on IoU and distance to the predicted center, all storage is
+// fixed-size and update() does not allocate.
+class Tracker {
+public:
+    explicit Tracker(const config_t &cfg);
+
+    // Associate the detections of one frame with the tracks. track_ids (optional,
+    // num_detections entries) receives the track id per detection, 0 if the
+    // detection was dropped because all track slots are in use.
+    void update(const box_t *detections, int num_detections, uint32_t *track_ids = nullptr);
+
+    // Active tracks, including unconfirmed ones and tracks that were not matched
+    // in the last frame (age > 0)
+    int num_tracks() const { return m_num_tracks; }
+    const track_t &track(int i) const { return m_tracks[i]; }
+
+    void reset();
+
+    const config_t &config() const { return m_cfg; }
+    const stats_t &stats() const { return m_stats; }
+
+private:
+    struct candidate_t {
+        float cost;
+        int8_t track;
+        int8_t detection;
+    };
+
+    bool match_cost(const track_t &track, const box_t &det, float &cost) const;
+    void add_track(const box_t &det, uint32_t *track_id);
+
+    config_t m_cfg;
+    track_t m_tracks[MAX_TRACKS];
+    int m_num_tracks;
+    uint32_t m_next_id;
+    candidate_t m_candidates[MAX_TRACKS * MAX_DETECTIONS];
+    stats_t m_stats;
+};
+
+} // namespace tracker
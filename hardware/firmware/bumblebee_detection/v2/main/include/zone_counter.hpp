@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "tracker.hpp"
+
+namespace counting {
+
+static constexpr int MAX_ZONES = 8;
+static constexpr int MAX_ZONE_POINTS = 8;
+static constexpr int ZONE_NAME_LEN = 16;
+
+enum direction_t {
+    EINFLUG,
+    AUSFLUG,
+};
+
+enum zone_type_t {
+    ZONE_LINE,    // segment points[0] -> points[1]
+    ZONE_POLYGON, // closed polygon, points in order
+};
+
+struct point_t {
+    int x, y;
+};
+
+// A counting zone in camera coordinates.
+// A line counts tracks whose center crosses the segment. The direction vector (dx, dy)
+// points to the side that is reached by an Einflug, so the camera may look at the
+// entrance from any angle. A polygon counts tracks entering and leaving it; entering
+// is an Einflug, or an Ausflug with enter_is_einflug = false.
+struct zone_t {
+    char name[ZONE_NAME_LEN];
+    zone_type_t type;
+    point_t points[MAX_ZONE_POINTS];
+    int num_points;
+    int dx, dy;            // ZONE_LINE
+    bool enter_is_einflug; // ZONE_POLYGON
+};
+
+struct crossing_t {
+    uint32_t track_id;
+    uint8_t zone; // index into the zones of the counter
+    direction_t direction;
+};
+
+// Horizontal line at camera row y, reaching beyond any frame. Top to bottom is an
+// Ausflug, bottom to top an Einflug, like the former fixed counting line.
+zone_t horizontal_line(int y);
+
+// false (and a log message) if the zone cannot count: too few points, a line of
+// length 0 or a direction parallel to it
+bool validate(const zone_t &zone);
+
+// Parse a zone file, one zone per line, '#' starts a comment:
+//   line <name> <x0> <y0> <x1> <y1> <dx> <dy>
+//   poly <name> in|out <x0> <y0> <x1> <y1> <x2> <y2> ...
+// "in" makes entering the polygon an Einflug, "out" an Ausflug.
+// Returns the number of zones, or -1 if a line is malformed or a zone invalid.
+int parse_zones(const char *text, zone_t *zones, int max_zones);
+
+// Read and parse a zone file, -1 if it cannot be opened or parsed
+int load_zones(const char *path, zone_t *zones, int max_zones);
+
+// Counts confirmed tracks crossing any number of zones, each with its own counters.
+// update() looks only at the previous and current center of each track matched in
+// the frame, so it is O(tracks x zones) and does not allocate.
+class ZoneCounter {
+public:
+    ZoneCounter();
+
+    // Replace the zones and reset all counters. Returns false and keeps the
+    // current zones if one is invalid or there are more than MAX_ZONES.
+    bool set_zones(const zone_t *zones, int num_zones);
+
+    // Check the tracks matched in the last Tracker::update(), returns the crossings in this frame
+    int update(const tracker::Tracker &tracks);
+
+    int num_zones() const { return m_num_zones; }
+    const zone_t &zone(int i) const { return m_zones[i]; }
+    int einflug(int zone) const { return m_einflug[zone]; }
+    int ausflug(int zone) const { return m_ausflug[zone]; }
+
+    // Sums over all zones
+    int einflug() const;
+    int ausflug() const;
+
+    // Crossings of the last update()
+    int num_last_crossings() const { return m_num_last; }
+    const crossing_t &last_crossing(int i) const { return m_last[i]; }
+
+private:
+    zone_t m_zones[MAX_ZONES];
+    int m_num_zones;
+    int m_einflug[MAX_ZONES];
+    int m_ausflug[MAX_ZONES];
+    crossing_t m_last[tracker::MAX_TRACKS * MAX_ZONES];
+    int m_num_last;
+};
+
+} // namespace counting
@@ -0,0 +1,216 @@
+#include "camera.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_pm.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sensor.h"
+#include "camera_pins.h"
+
+namespace camera {
+
+static const char *TAG = "CAM";
+
+// Full frame the camera coordinates refer to (QVGA)
+static constexpr int FULL_WIDTH = 320;
+static constexpr int FULL_HEIGHT = 240;
+
+// Sensor window, a frame size from the driver's table because the frame buffer
+// size is fixed by the frame size at init
+static constexpr framesize_t WINDOW_FRAMESIZE = FRAMESIZE_240X240;
+static constexpr int WINDOW_SIZE = 240;
+
+// Sensor start-up after leaving power-down
+static constexpr int POWER_UP_MS = 10;
+
+// OV2640 CIF mode (ov2640_sensor_mode_t, not exported by the driver): a 400x296
+// sensor area, which set_framesize scales to QVGA for 4:3 frames
+static constexpr int OV2640_MODE_CIF = 2;
+static constexpr int OV2640_CIF_WIDTH = 400;
+static constexpr int OV2640_CIF_HEIGHT = 296;
+
+// Camera Module pin mapping
+static camera_config_t camera_config = {
+    .pin_pwdn = PWDN_GPIO_NUM,
+    .pin_reset = RESET_GPIO_NUM,
+    .pin_xclk = XCLK_GPIO_NUM,
+    .pin_sscb_sda = SIOD_GPIO_NUM,
+    .pin_sscb_scl = SIOC_GPIO_NUM,
+
+    .pin_d7 = Y9_GPIO_NUM,
+    .pin_d6 = Y8_GPIO_NUM,
+    .pin_d5 = Y7_GPIO_NUM,
+    .pin_d4 = Y6_GPIO_NUM,
+    .pin_d3 = Y5_GPIO_NUM,
+    .pin_d2 = Y4_GPIO_NUM,
+    .pin_d1 = Y3_GPIO_NUM,
+    .pin_d0 = Y2_GPIO_NUM,
+
+    .pin_vsync = VSYNC_GPIO_NUM,
+    .pin_href = HREF_GPIO_NUM,
+    .pin_pclk = PCLK_GPIO_NUM,
+
+    .xclk_freq_hz = 20000000, // XCLK 20MHz or 10MHz for OV2640 double FPS (Experimental)
+    .ledc_timer = LEDC_TIMER_0,
+    .ledc_channel = LEDC_CHANNEL_0,
+
+    .pixel_format = PIXFORMAT_RGB565, // PIXFORMAT_RGB565 , PIXFORMAT_JPEG
+    .frame_size = FRAMESIZE_QVGA, // [<<320x240>> (QVGA, 4:3); FRAMESIZE_320X320, 240x176 (HQVGA, 15:11); 400x296 (CIF,
+                                  // 50:37)],FRAMESIZE_QVGA,FRAMESIZE_VGA
+
+    .jpeg_quality = 8, // 0-63 lower number means higher quality.  Reduce quality if stack overflow in cam_task
+    .fb_count = 2,     // set from config_t in init()
+    .fb_location = CAMERA_FB_IN_PSRAM,
+    .grab_mode = CAMERA_GRAB_WHEN_EMPTY,
+    .sccb_i2c_port = 0 // optional
+};
+
+static frame::rect_t g_window = {0, 0, FULL_WIDTH, FULL_HEIGHT};
+static stats_t g_stats = {};
+static bool g_powered = true;
+#if CONFIG_PM_ENABLE
+static esp_pm_lock_handle_t g_pm_lock = nullptr;
+#endif
+
+// --------- Internal helpers ----------------------------------
+
+// Window of WINDOW_SIZE x WINDOW_SIZE QVGA pixels centered on the ROI, inside the frame
+static bool place_window(const frame::rect_t &roi, frame::rect_t &window) {
+    if (roi.w > WINDOW_SIZE || roi.h > WINDOW_SIZE) {
+        ESP_LOGW(TAG, "ROI %dx%d does not fit into the %dx%d sensor window", roi.w, roi.h, WINDOW_SIZE, WINDOW_SIZE);
+        return false;
+    }
+    window = {roi.x + roi.w / 2 - WINDOW_SIZE / 2, roi.y + roi.h / 2 - WINDOW_SIZE / 2, WINDOW_SIZE, WINDOW_SIZE};
+    frame::clamp_rect(window, FULL_WIDTH, FULL_HEIGHT);
+    return true;
+}
+
+// Program the OV2640 so it reads only the window, at the same scale as the QVGA frame
+static bool set_sensor_window(const frame::rect_t &window) {
+    sensor_t *s = esp_camera_sensor_get();
+    if (!s || s->id.PID != OV2640_PID) {
+        ESP_LOGW(TAG, "Sensor windowing is only implemented for the OV2640");
+        return false;
+    }
+    const int offset_x = window.x * OV2640_CIF_WIDTH / FULL_WIDTH;
+    const int offset_y = window.y * OV2640_CIF_HEIGHT / FULL_HEIGHT;
+    const int total_x = window.w * OV2640_CIF_WIDTH / FULL_WIDTH;
+    const int total_y = window.h * OV2640_CIF_HEIGHT / FULL_HEIGHT;
+    if (s->set_res_raw(s, OV2640_MODE_CIF, 0, 0, 0, offset_x, offset_y, total_x, total_y,
+                       window.w, window.h, true, false) != 0) {
+        ESP_LOGE(TAG, "set_res_raw failed");
+        return false;
+    }
+    return true;
+}
+
+// --------- Public API ----------------------------------
+
+bool init(const config_t &cfg) {
+    frame::rect_t window = {0, 0, FULL_WIDTH, FULL_HEIGHT};
+    const bool use_window = cfg.sensor_window && place_window(cfg.roi, window);
+
+    camera_config.fb_count = cfg.fb_count;
+    camera_config.grab_mode = cfg.grab_latest ? CAMERA_GRAB_LATEST : CAMERA_GRAB_WHEN_EMPTY;
+    camera_config.frame_size = use_window ? WINDOW_FRAMESIZE : FRAMESIZE_QVGA;
+    esp_err_t err = esp_camera_init(&camera_config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Camera Init Failed");
+        return false;
+    }
+
+    if (use_window && !set_sensor_window(window)) {
+        // Back to the full frame, the frame buffers have to be sized for it again
+        esp_camera_deinit();
+        camera_config.frame_size = FRAMESIZE_QVGA;
+        if (esp_camera_init(&camera_config) != ESP_OK) {
+            ESP_LOGE(TAG, "Camera Init Failed");
+            return false;
+        }
+        window = {0, 0, FULL_WIDTH, FULL_HEIGHT};
+    }
+    g_window = window;
+
+#if CONFIG_PM_ENABLE
+    if (esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "camera", &g_pm_lock) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create the power management lock");
+        return false;
+    }
+    esp_pm_lock_acquire(g_pm_lock);
+#endif
+
+    ESP_LOGI(TAG, "%d frame buffers, %s, window %dx%d at (%d, %d)", cfg.fb_count,
+             cfg.grab_latest ? "grab latest" : "grab when empty", g_window.w, g_window.h, g_window.x, g_window.y);
+    return true;
+}
+
+camera_fb_t *grab() {
+    camera_fb_t *fb;
+    {
+        profiler::Scope scope(profiler::STAGE_CAPTURE);
+        fb = esp_camera_fb_get();
+    }
+    if (!fb) {
+        g_stats.failed++;
+        return nullptr;
+    }
+
+    // With CAMERA_GRAB_LATEST this stays below one frame period even after a slow iteration
+    const int64_t captured_us = int64_t(fb->timestamp.tv_sec) * 1000000 + fb->timestamp.tv_usec;
+    const int64_t age_us = std::max<int64_t>(0, esp_timer_get_time() - captured_us);
+    g_stats.frames++;
+    g_stats.age_us_sum += age_us;
+    g_stats.age_us_max = std::max(g_stats.age_us_max, age_us);
+    return fb;
+}
+
+void release(camera_fb_t *fb) {
+    esp_camera_fb_return(fb);
+}
+
+bool set_power(bool on, int settle_frames) {
+    if (PWDN_GPIO_NUM < 0) {
+        return false;
+    }
+    if (on == g_powered) {
+        return true;
+    }
+    if (on) {
+#if CONFIG_PM_ENABLE
+        esp_pm_lock_acquire(g_pm_lock);
+#endif
+        gpio_set_level(gpio_num_t(PWDN_GPIO_NUM), 0);
+        vTaskDelay(pdMS_TO_TICKS(POWER_UP_MS));
+        // The frame buffers still hold frames from before the power-down, the frames
+        // after it are taken while auto exposure and white balance still converge
+        for (int i = 0; i < camera_config.fb_count + settle_frames; ++i) {
+            camera_fb_t *fb = esp_camera_fb_get();
+            if (fb) {
+                esp_camera_fb_return(fb);
+            }
+        }
+    } else {
+        gpio_set_level(gpio_num_t(PWDN_GPIO_NUM), 1);
+        g_stats.power_downs++;
+#if CONFIG_PM_ENABLE
+        esp_pm_lock_release(g_pm_lock);
+#endif
+    }
+    g_powered = on;
+    return true;
+}
+
+frame::rect_t window() {
+    return g_window;
+}
+
+stats_t get_stats() {
+    return g_stats;
+}
+
+} // namespace camera
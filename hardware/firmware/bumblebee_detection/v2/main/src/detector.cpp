@@ -0,0 +1,238 @@
+#include "detector.hpp"
+
+#include "bumblebee_detect.hpp"
+#include "profiler.hpp"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "dl_image_jpeg.hpp"
+
+extern const uint8_t bumblebee_jpg_start[] asm("_binary_bumblebee_jpg_start");
+extern const uint8_t bumblebee_jpg_end[] asm("_binary_bumblebee_jpg_end");
+
+namespace detector {
+
+static const char *TAG = "DETECTOR";
+
+static BumblebeeDetect *g_detect_224 = nullptr;
+static BumblebeeDetect *g_detect_96 = nullptr;
+static mode_t g_mode = MODE_224;
+static float g_escalate_score = 0.25f;
+static filter_t g_filter = {bumblebee_detect::ESPDet::default_score_thr, bumblebee_detect::ESPDet::all_classes};
+static float g_nms_thr = bumblebee_detect::ESPDet::default_nms_thr;
+static int64_t g_load_time_us = 0;
+static int64_t g_last_inference_us = 0;
+static stats_t g_stats = {};
+
+// --------- Internal helpers ----------------------------------
+
+static bool needs_224(mode_t mode) {
+    return mode != MODE_96;
+}
+
+static bool needs_96(mode_t mode) {
+    return mode != MODE_224;
+}
+
+static bumblebee_detect::ESPDet::filter_t filter_224() {
+    return {g_filter.score_thr, g_filter.class_mask};
+}
+
+// In adaptive mode the 96x96 model only has to notice that something is there
+static bumblebee_detect::ESPDet::filter_t filter_96(mode_t mode) {
+    return {mode == MODE_ADAPTIVE ? g_escalate_score : g_filter.score_thr, g_filter.class_mask};
+}
+
+// The first inference allocates the model's tensors and fills the caches,
+// so do it once at boot with the embedded sample instead of on the first real frame.
+static void warm_up(BumblebeeDetect *detect, const char *name) {
+    dl::image::jpeg_img_t jpeg_img = {
+        .data = (void *)bumblebee_jpg_start,
+        .data_len = (size_t)(bumblebee_jpg_end - bumblebee_jpg_start),
+    };
+    dl::image::img_t img = dl::image::sw_decode_jpeg(jpeg_img, dl::image::DL_IMAGE_PIX_TYPE_RGB888);
+    if (!img.data) {
+        ESP_LOGW(TAG, "Could not decode warm-up image, skipping warm-up");
+        return;
+    }
+
+    int64_t start = esp_timer_get_time();
+    auto &results = detect->run(img);
+    int64_t elapsed = esp_timer_get_time() - start;
+    ESP_LOGI(TAG, "Warm-up inference (%s) took %lld us (%d results)", name, elapsed, (int)results.size());
+
+    heap_caps_free(img.data);
+}
+
+// Create or reload one model. force reloads a model that is already loaded.
+static bool load_one(BumblebeeDetect *&detect, BumblebeeDetect::model_type_t type, const char *name,
+                     const bumblebee_detect::ESPDet::filter_t &filter, bool force) {
+    if (detect && detect->is_loaded() && !force) {
+        detect->set_filter(filter);
+        return true;
+    }
+    int64_t start = esp_timer_get_time();
+    if (!detect) {
+        detect = new BumblebeeDetect(type, false, filter, g_nms_thr);
+    } else {
+        detect->set_filter(filter);
+        detect->reload();
+    }
+    int64_t elapsed = esp_timer_get_time() - start;
+    g_load_time_us += elapsed;
+
+    if (!detect->is_loaded()) {
+        ESP_LOGE(TAG, "Model %s could not be loaded", name);
+        return false;
+    }
+    ESP_LOGI(TAG, "Model %s loaded in %lld us", name, elapsed);
+
+    warm_up(detect, name);
+    return true;
+}
+
+static bool load(mode_t mode, bool force) {
+    g_load_time_us = 0;
+    if (needs_224(mode) &&
+        !load_one(g_detect_224, BumblebeeDetect::ESPDET_PICO_224_224_BUMBLEBEE, "224x224", filter_224(), force)) {
+        return false;
+    }
+    if (needs_96(mode) &&
+        !load_one(g_detect_96, BumblebeeDetect::ESPDET_PICO_96_96_BUMBLEBEE, "96x96", filter_96(mode), force)) {
+        return false;
+    }
+    return true;
+}
+
+static std::list<dl::detect::result_t> &run_model(BumblebeeDetect *detect, const dl::image::img_t &img) {
+    std::list<dl::detect::result_t> &results = detect->run(img);
+    if (const bumblebee_detect::ESPDet::timing_t *timing = detect->last_timing()) {
+        profiler::record(profiler::STAGE_PREPROCESS, timing->preprocess_us);
+        profiler::record(profiler::STAGE_MODEL, timing->model_us);
+        profiler::record(profiler::STAGE_POSTPROCESS, timing->postprocess_us);
+    }
+    g_stats.gated += detect->last_run_gated();
+    return results;
+}
+
+// Results of the 96x96 model on small_img in the coordinates of img
+static void scale_results(std::list<dl::detect::result_t> &results, const dl::image::img_t &from,
+                          const dl::image::img_t &to) {
+    for (dl::detect::result_t &res : results) {
+        for (size_t i = 0; i + 1 < res.box.size(); i += 2) {
+            res.box[i] = res.box[i] * to.width / from.width;
+            res.box[i + 1] = res.box[i + 1] * to.height / from.height;
+        }
+        for (size_t i = 0; i + 1 < res.keypoint.size(); i += 2) {
+            res.keypoint[i] = res.keypoint[i] * to.width / from.width;
+            res.keypoint[i + 1] = res.keypoint[i + 1] * to.height / from.height;
+        }
+    }
+}
+
+// --------- Public API ----------------------------------
+
+bool init(mode_t mode, const filter_t &filter, float escalate_score, float nms_thr) {
+    g_filter = filter;
+    g_escalate_score = escalate_score;
+    if (nms_thr >= 0.0f) {
+        g_nms_thr = nms_thr;
+    }
+    if (!load(mode, false)) {
+        return false;
+    }
+    g_mode = mode;
+    return true;
+}
+
+bool reload() {
+    ESP_LOGI(TAG, "Reloading model(s)");
+    return load(g_mode, true);
+}
+
+bool set_mode(mode_t mode) {
+    if (!load(mode, false)) {
+        ESP_LOGE(TAG, "set_mode: keeping mode %d", g_mode);
+        return false;
+    }
+    g_mode = mode;
+    return true;
+}
+
+mode_t get_mode() {
+    return g_mode;
+}
+
+void set_filter(const filter_t &filter) {
+    g_filter = filter;
+    if (g_detect_224) {
+        g_detect_224->set_filter(filter_224());
+    }
+    if (g_detect_96) {
+        g_detect_96->set_filter(filter_96(g_mode));
+    }
+    ESP_LOGI(TAG, "Filter: score > %.2f, class mask 0x%lx", g_filter.score_thr, (unsigned long)g_filter.class_mask);
+}
+
+filter_t get_filter() {
+    return g_filter;
+}
+
+bool is_loaded() {
+    return (!needs_224(g_mode) || (g_detect_224 && g_detect_224->is_loaded())) &&
+           (!needs_96(g_mode) || (g_detect_96 && g_detect_96->is_loaded()));
+}
+
+std::list<dl::detect::result_t> *run(const dl::image::img_t &img, bool tracks_active,
+                                     const dl::image::img_t *small_img) {
+    if (!is_loaded()) {
+        ESP_LOGE(TAG, "run: model not loaded");
+        return nullptr;
+    }
+    const dl::image::img_t &img_96 = small_img ? *small_img : img;
+
+    int64_t start = esp_timer_get_time();
+    std::list<dl::detect::result_t> *results = nullptr;
+    switch (g_mode) {
+    case MODE_224:
+        results = &run_model(g_detect_224, img);
+        g_stats.runs_224++;
+        break;
+    case MODE_96:
+        results = &run_model(g_detect_96, img_96);
+        scale_results(*results, img_96, img);
+        g_stats.runs_96++;
+        break;
+    case MODE_ADAPTIVE:
+        // Active tracks need the accurate boxes anyway, the cheap pre-check would only add time
+        if (!tracks_active) {
+            results = &run_model(g_detect_96, img_96);
+            scale_results(*results, img_96, img);
+            g_stats.runs_96++;
+            // Filtered at the escalate score, any result is a candidate
+            if (results->empty()) {
+                break;
+            }
+            g_stats.escalations++;
+        }
+        results = &run_model(g_detect_224, img);
+        g_stats.runs_224++;
+        break;
+    }
+    g_last_inference_us = esp_timer_get_time() - start;
+    return results;
+}
+
+int64_t load_time_us() {
+    return g_load_time_us;
+}
+
+int64_t last_inference_us() {
+    return g_last_inference_us;
+}
+
+stats_t get_stats() {
+    return g_stats;
+}
+
+} // namespace detector
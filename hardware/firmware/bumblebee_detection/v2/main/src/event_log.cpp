@@ -0,0 +1,200 @@
+#include "event_log.hpp"
+
+#include <unistd.h>
+
+#include "esp_log.h"
+
+namespace eventlog {
+
+static const char *TAG = "EVENTLOG";
+
+// --------- Public API ----------------------------------
+
+// CRC-32 (IEEE, reflected) as zlib.crc32. Bitwise, a block is only hashed when it is written.
+uint32_t crc32(const uint8_t *data, size_t len, uint32_t crc) {
+    crc = ~crc;
+    for (size_t i = 0; i < len; ++i) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+// --------- EventLog ----------------------------------
+
+EventLog::EventLog(uint32_t sync_interval_ms) :
+    m_sync_interval_ms(sync_interval_ms), m_file(nullptr), m_block_index(0), m_last_sync_ms(0), m_dirty(false),
+    m_has_pending(false), m_pending_index(0), m_block{}, m_pending{}, m_stats{}
+{
+}
+
+EventLog::~EventLog()
+{
+    close();
+}
+
+bool EventLog::open(const char *path, uint32_t time_ms, uint32_t unix_time)
+{
+    if (m_file) {
+        ESP_LOGE(TAG, "open: log already open");
+        return false;
+    }
+    m_file = fopen(path, "r+b");
+    if (!m_file) {
+        m_file = fopen(path, "w+b");
+    }
+    if (!m_file) {
+        ESP_LOGE(TAG, "Failed to open %s", path);
+        return false;
+    }
+    // Whole blocks go straight to the card, no stdio copy
+    setvbuf(m_file, nullptr, _IONBF, 0);
+
+    // Start after the last whole block, a torn block at the end is overwritten
+    fseek(m_file, 0, SEEK_END);
+    const long size = ftell(m_file);
+    m_block_index = size > 0 ? uint32_t(size / BLOCK_SIZE) : 0;
+    m_block = {};
+    m_has_pending = false;
+    m_last_sync_ms = time_ms;
+    ESP_LOGI(TAG, "Logging to %s from block %lu", path, (unsigned long)m_block_index);
+
+    record_t rec = {};
+    rec.time_ms = time_ms;
+    rec.type = REC_SESSION;
+    rec.session.unix_time = unix_time;
+    append(rec);
+    return sync(time_ms);
+}
+
+void EventLog::close()
+{
+    if (!m_file) {
+        return;
+    }
+    sync(m_last_sync_ms);
+    fclose(m_file);
+    m_file = nullptr;
+}
+
+void EventLog::detection(uint32_t time_ms, uint32_t frame_id, uint32_t track_id, int x1, int y1, int x2, int y2,
+                         float score)
+{
+    record_t rec = {};
+    rec.time_ms = time_ms;
+    rec.frame_id = frame_id;
+    rec.type = REC_DETECTION;
+    rec.track_id = uint16_t(track_id);
+    rec.detection = {int16_t(x1), int16_t(y1), int16_t(x2), int16_t(y2),
+                     uint16_t(score <= 0.0f ? 0 : score >= 1.0f ? 65535 : score * 65535.0f + 0.5f), 0};
+    append(rec);
+}
+
+void EventLog::crossing(uint32_t time_ms, uint32_t frame_id, uint32_t track_id, int zone, int direction,
+                        int einflug, int ausflug)
+{
+    record_t rec = {};
+    rec.time_ms = time_ms;
+    rec.frame_id = frame_id;
+    rec.type = REC_CROSSING;
+    rec.direction = uint8_t(direction);
+    rec.track_id = uint16_t(track_id);
+    rec.crossing = {einflug, ausflug, uint16_t(zone), 0};
+    append(rec);
+}
+
+void EventLog::tick(uint32_t time_ms)
+{
+    if (m_file && m_dirty && time_ms - m_last_sync_ms >= m_sync_interval_ms) {
+        sync(time_ms);
+    }
+}
+
+bool EventLog::sync(uint32_t time_ms)
+{
+    if (!m_file) {
+        return false;
+    }
+    m_last_sync_ms = time_ms;
+    if (!m_dirty) {
+        return true;
+    }
+    // The partial block is rewritten in place until it is full
+    bool ok = write_pending();
+    if (m_block.header.num_records > 0 && !write_block(m_block, m_block_index)) {
+        ok = false;
+    }
+    if (!ok) {
+        return false;
+    }
+    if (fsync(fileno(m_file)) != 0) {
+        ESP_LOGE(TAG, "fsync failed");
+        m_stats.errors++;
+        return false;
+    }
+    m_dirty = false;
+    m_stats.syncs++;
+    return true;
+}
+
+void EventLog::append(const record_t &rec)
+{
+    if (!m_file) {
+        return;
+    }
+    m_block.records[m_block.header.num_records++] = rec;
+    m_stats.records++;
+    m_dirty = true;
+
+    if (m_block.header.num_records == RECORDS_PER_BLOCK) {
+        write_pending();
+        if (!write_block(m_block, m_block_index)) {
+            if (m_has_pending) {
+                ESP_LOGE(TAG, "Block %lu lost, block %lu still waits for its retry",
+                         (unsigned long)m_block_index, (unsigned long)m_pending_index);
+                m_stats.lost++;
+            } else {
+                // Written again on the next sync, m_dirty keeps tick() trying
+                m_pending = m_block;
+                m_pending_index = m_block_index;
+                m_has_pending = true;
+            }
+        }
+        m_block_index++;
+        m_stats.blocks++;
+        m_block = {};
+    }
+}
+
+bool EventLog::write_block(block_t &block, uint32_t index)
+{
+    block.header.magic = MAGIC;
+    block.header.version = VERSION;
+    block.header.seq = index;
+    block.header.crc = 0;
+    block.header.crc = crc32(reinterpret_cast<const uint8_t *>(&block), BLOCK_SIZE);
+
+    if (fseek(m_file, long(index) * BLOCK_SIZE, SEEK_SET) != 0 ||
+        fwrite(&block, BLOCK_SIZE, 1, m_file) != 1) {
+        ESP_LOGE(TAG, "Failed to write block %lu", (unsigned long)index);
+        m_stats.errors++;
+        return false;
+    }
+    return true;
+}
+
+bool EventLog::write_pending()
+{
+    if (!m_has_pending) {
+        return true;
+    }
+    if (!write_block(m_pending, m_pending_index)) {
+        return false;
+    }
+    m_has_pending = false;
+    return true;
+}
+
+} // namespace eventlog
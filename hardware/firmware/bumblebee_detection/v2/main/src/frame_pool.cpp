@@ -0,0 +1,96 @@
+#include "frame_pool.hpp"
+
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+
+namespace frame_pool {
+
+static const char *TAG = "FRAME_POOL";
+
+static uint8_t *g_base = nullptr;
+static size_t g_capacity = 0;
+static size_t g_used = 0;
+
+// --------- Public API ----------------------------------
+
+bool reserve(size_t bytes) {
+    if (g_base) {
+        ESP_LOGE(TAG, "reserve: pool already reserved");
+        return false;
+    }
+    // Aligned to the largest cache line (P4 L2), so take() can hand out cache-line aligned buffers
+    g_base = static_cast<uint8_t *>(heap_caps_aligned_alloc(128, bytes, MALLOC_CAP_SPIRAM));
+    if (!g_base) {
+        ESP_LOGE(TAG, "Failed to reserve %u bytes in PSRAM", (unsigned)bytes);
+        return false;
+    }
+    g_capacity = bytes;
+    g_used = 0;
+    ESP_LOGI(TAG, "Reserved %u KB in PSRAM", (unsigned)(bytes / 1024));
+    return true;
+}
+
+void *take(size_t bytes, size_t align) {
+    const size_t offset = (g_used + align - 1) & ~(align - 1);
+    if (!g_base || offset + bytes > g_capacity) {
+        ESP_LOGE(TAG, "take: %u bytes do not fit (%u of %u used)", (unsigned)bytes, (unsigned)g_used,
+                 (unsigned)g_capacity);
+        return nullptr;
+    }
+    g_used = offset + bytes;
+    return g_base + offset;
+}
+
+size_t used() {
+    return g_used;
+}
+
+size_t capacity() {
+    return g_capacity;
+}
+
+#if CONFIG_BEESENSE_ALLOC_COUNTER
+// The counter of a watched task hangs in one of its thread-local storage pointers,
+// the heap hook below only has to look it up.
+// Index 0 belongs to pthread TLS. With deletion callbacks enabled (the IDF default)
+// configNUM_THREAD_LOCAL_STORAGE_POINTERS is twice the Kconfig value and the upper
+// half holds the callbacks, so the index is taken from the Kconfig value.
+static_assert(CONFIG_FREERTOS_THREAD_LOCAL_STORAGE_POINTERS >= 2,
+              "BEESENSE_ALLOC_COUNTER needs CONFIG_FREERTOS_THREAD_LOCAL_STORAGE_POINTERS >= 2");
+static constexpr BaseType_t TLS_INDEX = CONFIG_FREERTOS_THREAD_LOCAL_STORAGE_POINTERS - 1;
+#endif
+
+void count_allocations(uint32_t *counter) {
+#if CONFIG_BEESENSE_ALLOC_COUNTER
+#if configTHREAD_LOCAL_STORAGE_DELETE_CALLBACKS
+    // The counter is static, nothing to do when the task is deleted
+    vTaskSetThreadLocalStoragePointerAndDelCallback(nullptr, TLS_INDEX, counter, nullptr);
+#else
+    vTaskSetThreadLocalStoragePointer(nullptr, TLS_INDEX, counter);
+#endif
+#else
+    (void)counter;
+#endif
+}
+
+} // namespace frame_pool
+
+#if CONFIG_BEESENSE_ALLOC_COUNTER
+// Called by the heap for every successful allocation (CONFIG_HEAP_USE_HOOKS)
+extern "C" IRAM_ATTR void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps) {
+    if (xTaskGetSchedulerState() != taskSCHEDULER_RUNNING) {
+        return;
+    }
+    uint32_t *counter = static_cast<uint32_t *>(pvTaskGetThreadLocalStoragePointer(nullptr, frame_pool::TLS_INDEX));
+    if (counter) {
+        (*counter)++;
+    }
+}
+
+extern "C" IRAM_ATTR void esp_heap_trace_free_hook(void *ptr) {
+}
+#endif
@@ -0,0 +1,77 @@
+#include "frame_scheduler.hpp"
+
+#include "esp_log.h"
+
+namespace scheduler {
+
+static const char *TAG = "SCHEDULER";
+
+static const char *MODE_NAMES[MODE_COUNT] = {"active", "quiet", "night"};
+
+const char *mode_name(mode_t mode) {
+    return mode < MODE_COUNT ? MODE_NAMES[mode] : "?";
+}
+
+// --------- Scheduler ----------------------------------
+
+Scheduler::Scheduler(const config_t &cfg) :
+    m_cfg(cfg), m_mode(MODE_ACTIVE), m_started(false), m_last_ms(0), m_stats{}
+{
+}
+
+bool Scheduler::is_night(int hour) const
+{
+    if (hour < 0 || m_cfg.night_start_hour == m_cfg.night_end_hour) {
+        return false;
+    }
+    // The night window usually wraps around midnight
+    if (m_cfg.night_start_hour < m_cfg.night_end_hour) {
+        return hour >= m_cfg.night_start_hour && hour < m_cfg.night_end_hour;
+    }
+    return hour >= m_cfg.night_start_hour || hour < m_cfg.night_end_hour;
+}
+
+plan_t Scheduler::next(uint32_t now_ms, uint32_t last_activity_ms, int hour)
+{
+    mode_t mode = MODE_ACTIVE;
+    if (now_ms - last_activity_ms >= m_cfg.quiet_after_ms) {
+        mode = is_night(hour) ? MODE_NIGHT : MODE_QUIET;
+    }
+
+    // The time since the previous call belongs to the mode that was active then
+    if (m_started) {
+        m_stats.mode_ms[m_mode] += now_ms - m_last_ms;
+    }
+    m_started = true;
+    m_last_ms = now_ms;
+    if (mode != m_mode) {
+        ESP_LOGI(TAG, "%s -> %s", MODE_NAMES[m_mode], MODE_NAMES[mode]);
+        m_stats.switches++;
+        m_mode = mode;
+    }
+
+    plan_t plan = {mode, m_cfg.active_interval_ms, false};
+    if (mode == MODE_QUIET) {
+        plan.delay_ms = m_cfg.quiet_interval_ms;
+    } else if (mode == MODE_NIGHT) {
+        plan.delay_ms = m_cfg.night_interval_ms;
+    }
+    plan.power_down = mode != MODE_ACTIVE && plan.delay_ms >= m_cfg.power_down_min_ms;
+
+    m_stats.frames[mode]++;
+    m_stats.wait_ms[mode] += plan.delay_ms;
+    m_stats.power_downs += plan.power_down;
+    return plan;
+}
+
+float Scheduler::duty_cycle(mode_t mode) const
+{
+    const uint64_t total = m_stats.mode_ms[mode];
+    if (total == 0) {
+        return 1.0f;
+    }
+    const uint64_t wait = m_stats.wait_ms[mode] < total ? m_stats.wait_ms[mode] : total;
+    return float(total - wait) / float(total);
+}
+
+} // namespace scheduler
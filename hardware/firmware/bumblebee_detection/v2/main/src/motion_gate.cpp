@@ -0,0 +1,108 @@
+#include "motion_gate.hpp"
+
+#include <cstdlib>
+
+namespace motion {
+
+static constexpr int BG_FRAC_BITS = 4;
+
+// --------- Internal helpers ----------------------------------
+
+// BT.601 luma with 8-bit weights (77 + 150 + 29 = 256)
+static inline uint32_t luma(uint32_t r, uint32_t g, uint32_t b) {
+    return (77 * r + 150 * g + 29 * b) >> 8;
+}
+
+// --------- MotionGate ----------------------------------
+
+MotionGate::MotionGate(const config_t &cfg) :
+    m_cfg(cfg), m_cols(0), m_rows(0), m_has_background(false), m_changed_cells(0),
+    m_frames_since_inference(0), m_stats{}
+{
+}
+
+void MotionGate::compute_cells(const uint8_t *img, int width, bool rgb565)
+{
+    const int block = m_cfg.block_size;
+    const int bpp = rgb565 ? 2 : 3;
+    // Every second pixel of every second row is plenty for a mean over the cell,
+    // an odd block takes the first pixel of its last column and row as well
+    const int per_axis = (block + 1) / 2;
+    const int samples = per_axis * per_axis;
+
+    for (int cy = 0; cy < m_rows; ++cy) {
+        for (int cx = 0; cx < m_cols; ++cx) {
+            uint32_t sum = 0;
+            for (int y = cy * block; y < (cy + 1) * block; y += 2) {
+                const uint8_t *p = img + (y * width + cx * block) * bpp;
+                for (int x = 0; x < block; x += 2, p += 2 * bpp) {
+                    if (rgb565) {
+                        const uint32_t px = (uint32_t(p[0]) << 8) | p[1];
+                        sum += luma((px >> 8) & 0xF8, (px >> 3) & 0xFC, (px << 3) & 0xF8);
+                    } else {
+                        sum += luma(p[0], p[1], p[2]);
+                    }
+                }
+            }
+            m_cells[cy * m_cols + cx] = uint8_t(sum / samples);
+        }
+    }
+}
+
+bool MotionGate::update(const uint8_t *img, int width, int height, bool rgb565)
+{
+    m_stats.frames++;
+
+    const int cols = width / m_cfg.block_size;
+    const int rows = height / m_cfg.block_size;
+    if (cols * rows > MAX_GRID_CELLS || cols == 0 || rows == 0) {
+        // Unsupported geometry, never hide a frame from the detector
+        m_stats.motion++;
+        return true;
+    }
+    if (cols != m_cols || rows != m_rows) {
+        m_cols = cols;
+        m_rows = rows;
+        m_has_background = false;
+    }
+
+    compute_cells(img, width, rgb565);
+
+    const int n = m_cols * m_rows;
+    if (!m_has_background) {
+        for (int i = 0; i < n; ++i) {
+            m_background[i] = uint16_t(m_cells[i] << BG_FRAC_BITS);
+        }
+        m_has_background = true;
+        m_changed_cells = n;
+        m_frames_since_inference = 0;
+        m_stats.motion++;
+        return true;
+    }
+
+    int changed = 0;
+    for (int i = 0; i < n; ++i) {
+        const int cell = m_cells[i] << BG_FRAC_BITS;
+        const int diff = cell - m_background[i];
+        if (std::abs(diff) >= (m_cfg.cell_threshold << BG_FRAC_BITS)) {
+            changed++;
+        }
+        // Running average, so slow light changes end up in the background
+        m_background[i] = uint16_t(m_background[i] + (diff >> m_cfg.background_shift));
+    }
+    m_changed_cells = changed;
+
+    if (changed >= m_cfg.min_changed_cells) {
+        m_frames_since_inference = 0;
+        m_stats.motion++;
+        return true;
+    }
+    if (m_cfg.force_interval > 0 && ++m_frames_since_inference >= m_cfg.force_interval) {
+        m_frames_since_inference = 0;
+        m_stats.forced++;
+        return true;
+    }
+    return false;
+}
+
+} // namespace motion
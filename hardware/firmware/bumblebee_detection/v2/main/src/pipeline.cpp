@@ -0,0 +1,214 @@
+#include "pipeline.hpp"
+#include "frame_pool.hpp"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "sdkconfig.h"
+
+namespace pipeline {
+
+static const char *TAG = "PIPELINE";
+
+static constexpr int MAX_SLOTS = CONFIG_BEESENSE_FRAME_SLOTS + MAX_PRE_ROLL;
+
+static config_t g_cfg = {};
+static int g_num_slots = 0;
+static frame_t g_slots[MAX_SLOTS];
+
+// Frames that were not saved, oldest first. Only touched by the inference task.
+static frame_t *g_pre_roll[MAX_PRE_ROLL];
+static int g_pre_roll_count = 0;
+
+// free -> capture -> infer -> (store) -> free
+static QueueHandle_t g_free_q = nullptr;
+static QueueHandle_t g_infer_q = nullptr;
+static QueueHandle_t g_store_q = nullptr;
+
+static stats_t g_stats = {};
+
+// --------- Internal helpers ----------------------------------
+
+static size_t img_bytes(int size, dl::image::pix_type_t pix_type) {
+    const int bytes_per_pixel = pix_type == dl::image::DL_IMAGE_PIX_TYPE_RGB565 ? 2 : 3;
+    return size * size * bytes_per_pixel;
+}
+
+static bool alloc_img(dl::image::img_t &img, int size, dl::image::pix_type_t pix_type) {
+    img.width = size;
+    img.height = size;
+    img.pix_type = pix_type;
+    img.data = frame_pool::take(img_bytes(size, pix_type), frame::BUFFER_ALIGN);
+    return img.data != nullptr;
+}
+
+// All slot buffers come from one block reserved at boot, nothing is allocated afterwards
+static bool alloc_slots() {
+    const bool shared = g_cfg.model_pix_type == dl::image::DL_IMAGE_PIX_TYPE_RGB888;
+    size_t slot_bytes = img_bytes(g_cfg.img_size, dl::image::DL_IMAGE_PIX_TYPE_RGB888) + frame::BUFFER_ALIGN;
+    if (!shared) {
+        slot_bytes += img_bytes(g_cfg.img_size, g_cfg.model_pix_type) + frame::BUFFER_ALIGN;
+    }
+    if (g_cfg.small_img_size > 0) {
+        slot_bytes += img_bytes(g_cfg.small_img_size, g_cfg.model_pix_type) + frame::BUFFER_ALIGN;
+    }
+    if (!frame_pool::reserve(slot_bytes * g_num_slots)) {
+        return false;
+    }
+
+    for (int i = 0; i < g_num_slots; ++i) {
+        frame_t &slot = g_slots[i];
+        if (!alloc_img(slot.rgb888_img, g_cfg.img_size, dl::image::DL_IMAGE_PIX_TYPE_RGB888)) {
+            return false;
+        }
+        if (shared) {
+            slot.model_img = slot.rgb888_img;
+        } else if (!alloc_img(slot.model_img, g_cfg.img_size, g_cfg.model_pix_type)) {
+            return false;
+        }
+        if (g_cfg.small_img_size > 0 && !alloc_img(slot.small_img, g_cfg.small_img_size, g_cfg.model_pix_type)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void release(frame_t *frame) {
+    xQueueSend(g_free_q, &frame, portMAX_DELAY);
+}
+
+// Keep an unsaved frame as pre-roll, the oldest held frame goes back to the pool
+static void hold_pre_roll(frame_t *frame) {
+    if (g_cfg.pre_roll == 0) {
+        release(frame);
+        return;
+    }
+    if (g_pre_roll_count == g_cfg.pre_roll) {
+        release(g_pre_roll[0]);
+        for (int i = 1; i < g_pre_roll_count; ++i) {
+            g_pre_roll[i - 1] = g_pre_roll[i];
+        }
+        g_pre_roll_count--;
+    }
+    g_pre_roll[g_pre_roll_count++] = frame;
+}
+
+static void flush_pre_roll() {
+    for (int i = 0; i < g_pre_roll_count; ++i) {
+        xQueueSend(g_store_q, &g_pre_roll[i], portMAX_DELAY);
+        g_stats.pre_roll_stored++;
+    }
+    g_pre_roll_count = 0;
+}
+
+static void capture_task(void *arg) {
+    frame_pool::count_allocations(&g_stats.allocs_capture);
+    uint32_t next_id = 0;
+    while (true) {
+        frame_t *frame = nullptr;
+        xQueueReceive(g_free_q, &frame, portMAX_DELAY);
+
+        if (!g_cfg.capture(*frame)) {
+            g_stats.capture_failed++;
+            release(frame);
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+        frame->id = next_id++;
+        frame->timestamp_us = esp_timer_get_time();
+        frame->num_detections = 0;
+        frame->save = false;
+        frame->flush_pre_roll = false;
+        g_stats.captured++;
+
+        xQueueSend(g_infer_q, &frame, portMAX_DELAY);
+    }
+}
+
+static void inference_task(void *arg) {
+    frame_pool::count_allocations(&g_stats.allocs_inference);
+    while (true) {
+        frame_t *frame = nullptr;
+        xQueueReceive(g_infer_q, &frame, portMAX_DELAY);
+
+        g_cfg.infer(*frame);
+        g_stats.inferred++;
+
+        if (frame->save) {
+            if (frame->flush_pre_roll) {
+                flush_pre_roll();
+            }
+            xQueueSend(g_store_q, &frame, portMAX_DELAY);
+        } else {
+            hold_pre_roll(frame);
+        }
+    }
+}
+
+static void storage_task(void *arg) {
+    frame_pool::count_allocations(&g_stats.allocs_storage);
+    while (true) {
+        frame_t *frame = nullptr;
+        xQueueReceive(g_store_q, &frame, portMAX_DELAY);
+
+        g_cfg.store(*frame);
+        g_stats.stored++;
+
+        release(frame);
+    }
+}
+
+// --------- Public API ----------------------------------
+
+bool start(const config_t &cfg) {
+    if (g_free_q) {
+        ESP_LOGE(TAG, "start: pipeline already running");
+        return false;
+    }
+    if (cfg.pre_roll < 0 || cfg.pre_roll > MAX_PRE_ROLL) {
+        ESP_LOGE(TAG, "start: pre-roll must be between 0 and %d", MAX_PRE_ROLL);
+        return false;
+    }
+    g_cfg = cfg;
+    g_num_slots = CONFIG_BEESENSE_FRAME_SLOTS + cfg.pre_roll;
+
+    if (!alloc_slots()) {
+        ESP_LOGE(TAG, "Failed to allocate %d frame slots", g_num_slots);
+        return false;
+    }
+
+    g_free_q = xQueueCreate(g_num_slots, sizeof(frame_t *));
+    g_infer_q = xQueueCreate(g_num_slots, sizeof(frame_t *));
+    g_store_q = xQueueCreate(g_num_slots, sizeof(frame_t *));
+    if (!g_free_q || !g_infer_q || !g_store_q) {
+        ESP_LOGE(TAG, "Failed to create queues");
+        return false;
+    }
+    for (int i = 0; i < g_num_slots; ++i) {
+        frame_t *slot = &g_slots[i];
+        xQueueSend(g_free_q, &slot, 0);
+    }
+
+    // Storage first so that nothing blocks on a full store queue during start-up
+    if (xTaskCreatePinnedToCore(storage_task, "storage", 8 * 1024, nullptr, 3, nullptr,
+                                CONFIG_BEESENSE_STORAGE_CORE) != pdPASS ||
+        xTaskCreatePinnedToCore(inference_task, "inference", 16 * 1024, nullptr, 4, nullptr,
+                                CONFIG_BEESENSE_INFERENCE_CORE) != pdPASS ||
+        xTaskCreatePinnedToCore(capture_task, "capture", 4 * 1024, nullptr, 5, nullptr,
+                                CONFIG_BEESENSE_CAPTURE_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create pipeline tasks");
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Pipeline started: %d slots (%d pre-roll), capture core %d, inference core %d, storage core %d",
+             g_num_slots, cfg.pre_roll, CONFIG_BEESENSE_CAPTURE_CORE, CONFIG_BEESENSE_INFERENCE_CORE, CONFIG_BEESENSE_STORAGE_CORE);
+    return true;
+}
+
+stats_t get_stats() {
+    return g_stats;
+}
+
+} // namespace pipeline
@@ -0,0 +1,142 @@
+#include "profiler.hpp"
+
+#if CONFIG_BEESENSE_PROFILER
+#include <cstdio>
+#include <sys/stat.h>
+
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#endif
+
+namespace profiler {
+
+static const char *STAGE_NAMES[STAGE_COUNT] = {
+    "capture", "crop", "motion", "preprocess", "model", "postprocess",
+    "tracking", "convert", "draw", "jpeg_encode", "sd_write",
+};
+
+const char *stage_name(stage_t stage) {
+    return stage < STAGE_COUNT ? STAGE_NAMES[stage] : "?";
+}
+
+// --------- Histogram ----------------------------------
+
+// 0..3 map directly, above that 4 buckets per power of two
+static int bucket_index(uint32_t v) {
+    if (v < 4) {
+        return v;
+    }
+    const int msb = 31 - __builtin_clz(v);
+    const int index = (msb - 1) * 4 + ((v >> (msb - 2)) & 3);
+    return index < Histogram::NUM_BUCKETS ? index : Histogram::NUM_BUCKETS - 1;
+}
+
+static uint32_t bucket_mid(int index) {
+    if (index < 4) {
+        return index;
+    }
+    const int shift = index / 4 - 1;
+    const uint32_t lower = uint32_t(4 + index % 4) << shift;
+    return lower + ((1u << shift) >> 1);
+}
+
+void Histogram::add(uint32_t us) {
+    m_buckets[bucket_index(us)]++;
+    m_count++;
+    if (us > m_max) {
+        m_max = us;
+    }
+}
+
+void Histogram::reset() {
+    *this = Histogram();
+}
+
+uint32_t Histogram::percentile(float p) const {
+    if (m_count == 0) {
+        return 0;
+    }
+    const uint32_t target = uint32_t(p * (m_count - 1)) + 1;
+    uint32_t seen = 0;
+    for (int i = 0; i < NUM_BUCKETS; ++i) {
+        seen += m_buckets[i];
+        if (seen >= target) {
+            return bucket_mid(i) < m_max ? bucket_mid(i) : m_max;
+        }
+    }
+    return m_max;
+}
+
+#if CONFIG_BEESENSE_PROFILER
+
+static const char *TAG = "PROFILER";
+
+// Stages are recorded from tasks on both cores (STAGE_SD_WRITE by the storage task
+// and the SD writer), and dump() resets them while others add. add() is a handful of
+// instructions, so a spinlock is cheaper than per-task histograms.
+static portMUX_TYPE g_lock = portMUX_INITIALIZER_UNLOCKED;
+static Histogram g_stages[STAGE_COUNT];
+static Histogram g_snapshot[STAGE_COUNT]; // what dump() prints, outside the lock
+static uint32_t g_frames = 0;
+
+// --------- Public API ----------------------------------
+
+void record(stage_t stage, int64_t us) {
+    taskENTER_CRITICAL(&g_lock);
+    g_stages[stage].add(us < 0 ? 0 : uint32_t(us));
+    taskEXIT_CRITICAL(&g_lock);
+}
+
+void frame_done() {
+    if (++g_frames % CONFIG_BEESENSE_PROFILER_INTERVAL == 0) {
+        dump();
+    }
+}
+
+void dump() {
+    // Each dump covers the samples since the previous one
+    taskENTER_CRITICAL(&g_lock);
+    for (int i = 0; i < STAGE_COUNT; ++i) {
+        g_snapshot[i] = g_stages[i];
+        g_stages[i].reset();
+    }
+    taskEXIT_CRITICAL(&g_lock);
+
+    const size_t min_internal = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+    const size_t min_psram = heap_caps_get_minimum_free_size(MALLOC_CAP_SPIRAM);
+
+    ESP_LOGI(TAG, "--- %lu frames, stage: count p50 p95 p99 max (us) ---", g_frames);
+    struct stat st;
+    const bool new_file = stat(CONFIG_BEESENSE_PROFILER_CSV, &st) != 0 || st.st_size == 0;
+    FILE *csv = fopen(CONFIG_BEESENSE_PROFILER_CSV, "a");
+    if (!csv) {
+        ESP_LOGW(TAG, "Could not open %s, console only", CONFIG_BEESENSE_PROFILER_CSV);
+    } else if (new_file) {
+        fputs("frame,stage,count,p50_us,p95_us,p99_us,max_us,min_free_internal,min_free_psram\n", csv);
+    }
+
+    for (int i = 0; i < STAGE_COUNT; ++i) {
+        const Histogram &h = g_snapshot[i];
+        if (h.count() == 0) {
+            continue;
+        }
+        const uint32_t p50 = h.percentile(0.50f);
+        const uint32_t p95 = h.percentile(0.95f);
+        const uint32_t p99 = h.percentile(0.99f);
+        ESP_LOGI(TAG, "%-12s %6lu %8lu %8lu %8lu %8lu", STAGE_NAMES[i], h.count(), p50, p95, p99, h.max());
+        if (csv) {
+            fprintf(csv, "%lu,%s,%lu,%lu,%lu,%lu,%lu,%u,%u\n", g_frames, STAGE_NAMES[i], h.count(), p50, p95, p99,
+                    h.max(), (unsigned)min_internal, (unsigned)min_psram);
+        }
+    }
+    ESP_LOGI(TAG, "heap low-water: internal %u bytes, PSRAM %u bytes", (unsigned)min_internal, (unsigned)min_psram);
+
+    if (csv) {
+        fclose(csv);
+    }
+}
+
+#endif
+
+} // namespace profiler
@@ -0,0 +1,49 @@
+#include "save_policy.hpp"
+
+namespace save_policy {
+
+SavePolicy::SavePolicy(const config_t &cfg) :
+    m_cfg(cfg), m_post_roll_left(0), m_frames_since_save(0), m_stats{}
+{
+}
+
+decision_t SavePolicy::evaluate(const frame_info_t &info)
+{
+    decision_t decision = {};
+    m_stats.frames++;
+
+    const bool detection_event =
+        (m_cfg.modes & SAVE_DETECTIONS) && info.num_detections > 0 && info.max_score >= m_cfg.min_score;
+    const bool crossing_event = (m_cfg.modes & SAVE_CROSSINGS) && info.crossings > 0;
+
+    if (detection_event || crossing_event) {
+        decision.save = true;
+        decision.event = true;
+        // Frames that were already saved are not held, so this only emits frames
+        // from before the event.
+        decision.flush_pre_roll = m_cfg.pre_roll > 0;
+        m_post_roll_left = m_cfg.post_roll;
+        m_stats.events++;
+    } else if (m_post_roll_left > 0) {
+        m_post_roll_left--;
+        decision.save = true;
+    }
+
+    if (m_cfg.modes & SAVE_ALL) {
+        decision.save = true;
+    }
+
+    m_frames_since_save++;
+    if (!decision.save && m_cfg.keyframe_interval > 0 && m_frames_since_save >= m_cfg.keyframe_interval) {
+        decision.save = true;
+        m_stats.keyframes++;
+    }
+
+    if (decision.save) {
+        m_frames_since_save = 0;
+        m_stats.saved++;
+    }
+    return decision;
+}
+
+} // namespace save_policy
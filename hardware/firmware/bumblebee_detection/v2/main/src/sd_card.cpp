@@ -1,21 +1,37 @@
 #include "sd_card.hpp"
+#include "sd_writer.hpp"
+#include "file_naming.hpp"
+#include "profiler.hpp"
 
+#include "sdkconfig.h"
 #include "esp_log.h"
 #include "esp_err.h"
+#include "esp_heap_caps.h"
 #include "esp_vfs_fat.h"
 #include "sdmmc_cmd.h"
 #include "driver/sdspi_host.h"
 #include "driver/gpio.h"
+#if CONFIG_BEESENSE_SD_SDMMC
+#include "driver/sdmmc_host.h"
+#if CONFIG_BEESENSE_SD_SDMMC_LDO_CHAN >= 0
+#include "sd_pwr_ctrl_by_on_chip_ldo.h"
+#endif
+#endif
 
 
 #include <sys/stat.h>
 #include <time.h>
-#include <dirent.h>
 #include <cstring>
 #include <cstdio>
+#include <algorithm>
+#include <cstdlib>
 #include "ff.h" // Für FATFS Zeitstempel
 
 #include "esp_jpeg_enc.h"
+#if CONFIG_BEESENSE_P4_HW_IMAGE
+#include "driver/jpeg_encode.h"
+#include "frame_convert.hpp"
+#endif
 #include "dl_image_jpeg.hpp"
 
 #include "include/sd_pins.h"  // the board-specific SD + SPI pins
@@ -28,8 +44,13 @@ static constexpr const char *MOUNT_POINT = "/sdcard";
 static sdmmc_card_t *g_card = nullptr;
 static bool g_mounted = false;
 
+// Sharded output file names, see file_naming.hpp
+static naming::FileNamer g_namer(CONFIG_BEESENSE_SD_FILES_PER_DIR);
+static int g_jpeg_quality = 80;
+
 // --------- Internal helpers ----------------------------------
 
+#if !CONFIG_BEESENSE_SD_SDMMC
 static void init_sd_enable_pin(void) {
     gpio_config_t io_conf = {};
     io_conf.pin_bit_mask = (1ULL << SD_ENABLE);
@@ -42,7 +63,97 @@ static void init_sd_enable_pin(void) {
     // Active level depends on hardware
     gpio_set_level(SD_ENABLE, 0);
 }
+#endif
+
+static const esp_vfs_fat_sdmmc_mount_config_t MOUNT_CONFIG = {
+    // If format_if_mount_failed is set to true, SD card will be partitioned and
+    // formatted in case when mounting fails.
+    .format_if_mount_failed = false,
+    .max_files = 5,
+    .allocation_unit_size = 16 * 1024,
+    .disk_status_check_enable = false,
+    .use_one_fat = false
+};
+
+static void log_mount_error(esp_err_t ret, int freq_khz) {
+    if (ret == ESP_FAIL) {
+        ESP_LOGE(TAG, "Failed to mount filesystem (ret == ESP_FAIL). "
+                      "If you want the card to be formatted, set format_if_mount_failed.");
+    } else {
+        ESP_LOGE(TAG, "Failed to initialize the card at %d kHz (%s). "
+                      "Make sure SD card lines have pull-up resistors in place.",
+                 freq_khz, esp_err_to_name(ret));
+    }
+}
+
+// Next lower clock to try after a failed mount, 0 if there is none left
+static int fallback_freq_khz(int freq_khz) {
+    if (freq_khz <= SDMMC_FREQ_PROBING) {
+        return 0;
+    }
+    return std::max(freq_khz / 2, (int)SDMMC_FREQ_PROBING);
+}
+
+static void mounted_successfully(int freq_khz) {
+    // Card has been initialized, print its properties
+    sdmmc_card_print_info(stdout, g_card);
+    g_mounted = true;
+    ESP_LOGI(TAG, "SD card mounted successfully at %d kHz", freq_khz);
+}
+
+#if CONFIG_BEESENSE_SD_SDMMC
+// SDMMC host in 1- or 4-bit mode, e.g. on the ESP32-P4 function EV board
+static bool mount_sdcard_sdmmc() {
+    if (g_mounted) {
+        return true;
+    }
+
+    ESP_LOGI(TAG, "Initializing SD card over SDMMC (%d-bit)", CONFIG_BEESENSE_SD_SDMMC_BUS_WIDTH);
+
+    sdmmc_host_t host = SDMMC_HOST_DEFAULT();
+    host.slot = CONFIG_BEESENSE_SD_SDMMC_SLOT;
+
+#if CONFIG_BEESENSE_SD_SDMMC_LDO_CHAN >= 0
+    // The card is powered from an on-chip LDO channel
+    sd_pwr_ctrl_ldo_config_t ldo_config = {
+        .ldo_chan_id = CONFIG_BEESENSE_SD_SDMMC_LDO_CHAN,
+    };
+    sd_pwr_ctrl_handle_t pwr_ctrl_handle = nullptr;
+    esp_err_t ret = sd_pwr_ctrl_new_on_chip_ldo(&ldo_config, &pwr_ctrl_handle);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to create on-chip LDO power control driver: %s", esp_err_to_name(ret));
+        return false;
+    }
+    host.pwr_ctrl_handle = pwr_ctrl_handle;
+#endif
+
+    sdmmc_slot_config_t slot_config = SDMMC_SLOT_CONFIG_DEFAULT();
+    slot_config.width = CONFIG_BEESENSE_SD_SDMMC_BUS_WIDTH;
+#if CONFIG_SOC_SDMMC_USE_GPIO_MATRIX
+    slot_config.clk = (gpio_num_t)CONFIG_BEESENSE_SD_SDMMC_PIN_CLK;
+    slot_config.cmd = (gpio_num_t)CONFIG_BEESENSE_SD_SDMMC_PIN_CMD;
+    slot_config.d0 = (gpio_num_t)CONFIG_BEESENSE_SD_SDMMC_PIN_D0;
+#if CONFIG_BEESENSE_SD_SDMMC_BUS_WIDTH == 4
+    slot_config.d1 = (gpio_num_t)CONFIG_BEESENSE_SD_SDMMC_PIN_D1;
+    slot_config.d2 = (gpio_num_t)CONFIG_BEESENSE_SD_SDMMC_PIN_D2;
+    slot_config.d3 = (gpio_num_t)CONFIG_BEESENSE_SD_SDMMC_PIN_D3;
+#endif
+#endif
+    slot_config.flags |= SDMMC_SLOT_FLAG_INTERNAL_PULLUP;
 
+    ESP_LOGI(TAG, "Mounting FAT filesystem at %s", MOUNT_POINT);
+    for (int freq_khz = CONFIG_BEESENSE_SD_FREQ_KHZ; freq_khz > 0; freq_khz = fallback_freq_khz(freq_khz)) {
+        host.max_freq_khz = freq_khz;
+        esp_err_t err = esp_vfs_fat_sdmmc_mount(MOUNT_POINT, &host, &slot_config, &MOUNT_CONFIG, &g_card);
+        if (err == ESP_OK) {
+            mounted_successfully(freq_khz);
+            return true;
+        }
+        log_mount_error(err, freq_khz);
+    }
+    return false;
+}
+#else
 static bool mount_sdcard_spi() {
     if (g_mounted) {
         return true;
@@ -51,26 +162,13 @@ static bool mount_sdcard_spi() {
     init_sd_enable_pin();
     esp_err_t ret;
 
-    // Options for mounting the filesystem.
-    // If format_if_mount_failed is set to true, SD card will be partitioned and
-    // formatted in case when mounting fails.
-    esp_vfs_fat_sdmmc_mount_config_t mount_config = {
-        .format_if_mount_failed = false,
-        .max_files = 5,
-        .allocation_unit_size = 16 * 1024,
-        .disk_status_check_enable = false,
-        .use_one_fat = false
-    };
-
     ESP_LOGI(TAG, "Initializing SD card over SPI");
 
-    // By default, SD card frequency is initialized to SDMMC_FREQ_DEFAULT (20MHz)
-    // For setting a specific frequency, use host.max_freq_khz (range 400kHz - 20MHz for SDSPI)
-    // Example: for fixed frequency of 10MHz, use host.max_freq_khz = 10000;
+    // SD card frequency and DMA transfer size are set in menuconfig (BeeSense -> SD card).
+    // SDSPI is specified up to 20 MHz, many cards also work at 40 MHz.
     // host.'slot' should be set to an sdspi device initialized by `sdspi_host_init_device()`.
     // SDSPI_HOST_DEFAULT: https://github.com/espressif/esp-idf/blob/1bbf04cb4cf54d74c1fe21ed12dbf91eb7fb1019/components/esp_driver_sdspi/include/driver/sdspi_host.h#L44
     sdmmc_host_t host = SDSPI_HOST_DEFAULT();
-    host.max_freq_khz = 5000;
 
     constexpr spi_host_device_t SPI_HOST_ID = SPI3_HOST;
     host.slot = SPI_HOST_ID;
@@ -81,7 +179,7 @@ static bool mount_sdcard_spi() {
     bus_cfg.sclk_io_num      = PIN_NUM_CLK;
     bus_cfg.quadwp_io_num    = -1;
     bus_cfg.quadhd_io_num    = -1;
-    bus_cfg.max_transfer_sz  = 4000;
+    bus_cfg.max_transfer_sz  = CONFIG_BEESENSE_SD_SPI_MAX_TRANSFER_SIZE;
 
     ESP_LOGI(TAG, "Initializing SPI bus");
     ret = spi_bus_initialize(SPI_HOST_ID, &bus_cfg, SDSPI_DEFAULT_DMA);
@@ -110,125 +208,253 @@ static bool mount_sdcard_spi() {
     // spi_host_device_t host_id; ///< SPI host to use, SPIx_HOST (see spi_types.h)
     ESP_LOGI(TAG, "Mounting FAT filesystem at %s", MOUNT_POINT);
     // gpio_set_level(SD_ENABLE, 1);
-    ret = esp_vfs_fat_sdspi_mount(MOUNT_POINT, &host, &slot_config, &mount_config, &g_card);
+    // Not every card/wiring runs at the configured clock, step down until the card comes up
+    for (int freq_khz = CONFIG_BEESENSE_SD_FREQ_KHZ; freq_khz > 0; freq_khz = fallback_freq_khz(freq_khz)) {
+        host.max_freq_khz = freq_khz;
+        ret = esp_vfs_fat_sdspi_mount(MOUNT_POINT, &host, &slot_config, &MOUNT_CONFIG, &g_card);
+        if (ret == ESP_OK) {
+            mounted_successfully(freq_khz);
+            return true;
+        }
+        log_mount_error(ret, freq_khz);
+    }
 
-    if (ret != ESP_OK) {
-        if (ret == ESP_FAIL) {
-            ESP_LOGE("SD", "Failed to mount filesystem (ret == ESP_FAIL). Look into esp_vfs_fat_sdspi_mount() "
-                           "If you want the card to be formatted, set the CONFIG_EXAMPLE_FORMAT_IF_MOUNT_FAILED menuconfig option.");
-        } else {
-            ESP_LOGE("SD", "Failed to initialize the card (%s). Look into esp_vfs_fat_sdspi_mount() "
-                           "Make sure SD card lines have pull-up resistors in place.",
-                     esp_err_to_name(ret));
-            }
+    spi_bus_free(SPI_HOST_ID);
+    return false;
+}
+#endif
+
+// The encoder (including its Huffman helper task) and the output buffer are kept
+// across frames and only recreated when the image size or quality changes.
+// Only used from the storage task, so no locking.
+struct jpeg_encoder_t {
+    jpeg_enc_handle_t handle;
+    jpeg_enc_config_t cfg;
+    uint8_t *outbuf;
+    int outbuf_size;
+};
+static jpeg_encoder_t g_encoder = {};
+static constexpr int JPEG_OUTBUF_SIZE = 100 * 1024;     // 100 KB
+static constexpr int JPEG_OUTBUF_MAX_SIZE = 400 * 1024; // upper limit when growing
+
+static bool same_enc_config(const jpeg_enc_config_t &a, const jpeg_enc_config_t &b) {
+    return a.width == b.width && a.height == b.height && a.src_type == b.src_type &&
+           a.subsampling == b.subsampling && a.quality == b.quality && a.rotate == b.rotate;
+}
+
+static bool alloc_outbuf(int size) {
+    uint8_t *buf = static_cast<uint8_t *>(heap_caps_aligned_alloc(16, size, MALLOC_CAP_SPIRAM));
+    if (!buf) {
         return false;
     }
-
-    // Card has been initialized, print its properties
-    sdmmc_card_print_info(stdout, g_card);
-    g_mounted = true;
-    ESP_LOGI(TAG, "SD card mounted successfully");
+    heap_caps_free(g_encoder.outbuf);
+    g_encoder.outbuf = buf;
+    g_encoder.outbuf_size = size;
     return true;
 }
 
-// Encode an RGB888 image to JPEG into jpeg_img.
-// img.pix_type must be DL_IMAGE_PIX_TYPE_RGB888.
-static jpeg_error_t encode_img_to_jpeg(const dl::image::img_t *img, dl::image::jpeg_img_t *jpeg_img, jpeg_enc_config_t cfg) {
-    jpeg_enc_handle_t jpeg_enc = nullptr;
-    jpeg_error_t ret = jpeg_enc_open(&cfg, &jpeg_enc);
+static jpeg_error_t prepare_encoder(const jpeg_enc_config_t &cfg) {
+    if (g_encoder.handle && same_enc_config(g_encoder.cfg, cfg)) {
+        return JPEG_ERR_OK;
+    }
+    if (g_encoder.handle) {
+        jpeg_enc_close(g_encoder.handle);
+        g_encoder.handle = nullptr;
+    }
+
+    g_encoder.cfg = cfg;
+    jpeg_error_t ret = jpeg_enc_open(&g_encoder.cfg, &g_encoder.handle);
     if (ret != JPEG_ERR_OK) {
+        g_encoder.handle = nullptr;
         return ret;
     }
+    ESP_LOGI(TAG, "JPEG encoder opened for %dx%d, quality %d", cfg.width, cfg.height, cfg.quality);
 
-    const int outbuf_size = 100 * 1024; // 100 KB
-    uint8_t *outbuf = static_cast<uint8_t*>(calloc(1, outbuf_size));
-    if (!outbuf) {
-        jpeg_enc_close(jpeg_enc);
+    if (!g_encoder.outbuf && !alloc_outbuf(JPEG_OUTBUF_SIZE)) {
         return JPEG_ERR_NO_MEM;
     }
+    return JPEG_ERR_OK;
+}
 
-    const int in_size = img->width * img->height * 3; // RGB888
-    int out_len = 0;
-    ret = jpeg_enc_process(jpeg_enc, static_cast<const uint8_t*>(img->data), in_size, outbuf, outbuf_size, &out_len);
-    if (ret == JPEG_ERR_OK) {
-        jpeg_img->data = outbuf;
-        jpeg_img->data_len = out_len;
-    } else {
-        free(outbuf);
+#if CONFIG_BEESENSE_P4_HW_IMAGE
+// Hardware JPEG codec of the ESP32-P4. Takes the same config as the software encoder;
+// frames it cannot take (unaligned input, driver errors) go to esp_new_jpeg instead.
+struct hw_jpeg_encoder_t {
+    jpeg_encoder_handle_t handle;
+    uint8_t *inbuf;  // B, G, R copy of the image, written by the PPA
+    size_t inbuf_size;
+    uint8_t *outbuf; // both from jpeg_alloc_encoder_mem(), DMA capable and cache-line aligned
+    size_t outbuf_size;
+    bool unavailable;
+};
+static hw_jpeg_encoder_t g_hw_encoder = {};
+
+// jpeg_encoder_process() reports a bitstream that does not fit the output buffer as this
+static constexpr esp_err_t HW_JPEG_OUTBUF_TOO_SMALL = ESP_ERR_INVALID_SIZE;
+
+static bool alloc_hw_outbuf(size_t size) {
+    jpeg_encode_memory_alloc_cfg_t mem_cfg = {};
+    mem_cfg.buffer_direction = JPEG_ENC_ALLOC_OUTPUT_BUFFER;
+    size_t allocated = 0;
+    uint8_t *buf = static_cast<uint8_t *>(jpeg_alloc_encoder_mem(size, &mem_cfg, &allocated));
+    if (!buf) {
+        return false;
     }
-
-    jpeg_enc_close(jpeg_enc);
-    return ret;
+    free(g_hw_encoder.outbuf);
+    g_hw_encoder.outbuf = buf;
+    g_hw_encoder.outbuf_size = allocated;
+    return true;
 }
 
-// --------- Public API ----------------------------------
+static bool alloc_hw_inbuf(size_t size) {
+    if (g_hw_encoder.inbuf_size >= size) {
+        return true;
+    }
+    jpeg_encode_memory_alloc_cfg_t mem_cfg = {};
+    mem_cfg.buffer_direction = JPEG_ENC_ALLOC_INPUT_BUFFER;
+    size_t allocated = 0;
+    uint8_t *buf = static_cast<uint8_t *>(jpeg_alloc_encoder_mem(size, &mem_cfg, &allocated));
+    if (!buf) {
+        return false;
+    }
+    free(g_hw_encoder.inbuf);
+    g_hw_encoder.inbuf = buf;
+    g_hw_encoder.inbuf_size = allocated;
+    return true;
+}
 
-bool init() {
-    return mount_sdcard_spi();
+static bool prepare_hw_encoder() {
+    if (g_hw_encoder.handle) {
+        return true;
+    }
+    if (g_hw_encoder.unavailable) {
+        return false;
+    }
+    jpeg_encode_engine_cfg_t eng_cfg = {};
+    eng_cfg.intr_priority = 0;
+    eng_cfg.timeout_ms = 100;
+    esp_err_t err = jpeg_new_encoder_engine(&eng_cfg, &g_hw_encoder.handle);
+    if (err != ESP_OK || (!g_hw_encoder.outbuf && !alloc_hw_outbuf(JPEG_OUTBUF_SIZE))) {
+        ESP_LOGE(TAG, "Hardware JPEG encoder unavailable (%s), using esp_new_jpeg", esp_err_to_name(err));
+        if (g_hw_encoder.handle) {
+            jpeg_del_encoder_engine(g_hw_encoder.handle);
+            g_hw_encoder.handle = nullptr;
+        }
+        g_hw_encoder.unavailable = true;
+        return false;
+    }
+    ESP_LOGI(TAG, "Hardware JPEG encoder ready");
+    return true;
 }
 
-bool create_dir(const char *full_path) {
-    if (!g_mounted) {
-        ESP_LOGE(TAG, "create_dir: SD not mounted");
+static bool encode_img_to_jpeg_hw(const dl::image::img_t *img, dl::image::jpeg_img_t *jpeg_img, const jpeg_enc_config_t &cfg) {
+    if (!prepare_hw_encoder()) {
+        return false;
+    }
+    // JPEG_ENCODE_IN_FORMAT_RGB888 takes the pixels as little-endian 24-bit words, that is
+    // B, G, R in memory (like the decoder's default JPEG_DEC_RGB_ELEMENT_ORDER_BGR).
+    // The image is R, G, B, so the PPA writes a swapped copy into the codec's input buffer.
+    const uint32_t in_size = img->width * img->height * 3; // RGB888
+    if (!alloc_hw_inbuf(in_size) ||
+        !frame::ppa::to_bgr888(static_cast<const uint8_t *>(img->data), img->width, img->height,
+                               g_hw_encoder.inbuf, g_hw_encoder.inbuf_size)) {
         return false;
     }
 
-    struct stat st;
-    if (stat(full_path, &st) == 0) {
-        if (S_ISDIR(st.st_mode)) {
-            ESP_LOGI(TAG, "Dir already exists: %s", full_path);
+    jpeg_encode_cfg_t hw_cfg = {};
+    hw_cfg.width = cfg.width;
+    hw_cfg.height = cfg.height;
+    hw_cfg.src_type = JPEG_ENCODE_IN_FORMAT_RGB888;
+    hw_cfg.sub_sample = cfg.subsampling == JPEG_SUBSAMPLE_420 ? JPEG_DOWN_SAMPLING_YUV420 :
+                        cfg.subsampling == JPEG_SUBSAMPLE_422 ? JPEG_DOWN_SAMPLING_YUV422 :
+                                                                JPEG_DOWN_SAMPLING_YUV444;
+    hw_cfg.image_quality = cfg.quality;
+
+    while (true) {
+        uint32_t out_len = 0;
+        esp_err_t err = jpeg_encoder_process(g_hw_encoder.handle, &hw_cfg, g_hw_encoder.inbuf,
+                                             in_size, g_hw_encoder.outbuf, g_hw_encoder.outbuf_size, &out_len);
+        if (err == ESP_OK) {
+            jpeg_img->data = g_hw_encoder.outbuf;
+            jpeg_img->data_len = out_len;
             return true;
-        } else {
-            ESP_LOGE(TAG, "Path exists but is not a directory: %s", full_path);
-            return false;
         }
-    }
 
-    int res = mkdir(full_path, 0775);
-    if (res == 0) {
-        ESP_LOGI(TAG, "Created dir: %s", full_path);
-        return true;
-    } else {
-        ESP_LOGE(TAG, "mkdir failed for %s (errno=%d)", full_path, errno);
-        return false;
+        // Same growth as for the software encoder, but only if the output did not fit.
+        // Timeouts and other driver errors go to esp_new_jpeg straight away.
+        size_t new_size = g_hw_encoder.outbuf_size * 2;
+        if (err != HW_JPEG_OUTBUF_TOO_SMALL || new_size > JPEG_OUTBUF_MAX_SIZE || !alloc_hw_outbuf(new_size)) {
+            ESP_LOGW(TAG, "Hardware JPEG encoding failed (%s), using esp_new_jpeg", esp_err_to_name(err));
+            return false;
+        }
+        ESP_LOGW(TAG, "Hardware JPEG output buffer grown to %u bytes", (unsigned)new_size);
     }
 }
+#endif
 
-int count_files(const char *path) {
-    int count = 0;
-    DIR *dir = opendir(path);
-    if (!dir) {
-        ESP_LOGE("FILE_COUNT", "Failed to open directory: %s", path);
-        return -1;
+// Encode an RGB888 image to JPEG into jpeg_img.
+// img.pix_type must be DL_IMAGE_PIX_TYPE_RGB888.
+// jpeg_img points into the encoder's output buffer and stays valid until the next call.
+// With CONFIG_BEESENSE_P4_HW_IMAGE the P4's JPEG codec is tried first.
+static jpeg_error_t encode_img_to_jpeg(const dl::image::img_t *img, dl::image::jpeg_img_t *jpeg_img, const jpeg_enc_config_t &cfg) {
+#if CONFIG_BEESENSE_P4_HW_IMAGE
+    if (encode_img_to_jpeg_hw(img, jpeg_img, cfg)) {
+        return JPEG_ERR_OK;
+    }
+#endif
+    jpeg_error_t ret = prepare_encoder(cfg);
+    if (ret != JPEG_ERR_OK) {
+        return ret;
     }
 
-    struct dirent *entry;
-    while ((entry = readdir(dir)) != nullptr) {
-        // Skip current and parent directory entries
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-            continue;
+    const int in_size = img->width * img->height * 3; // RGB888
+    while (true) {
+        int out_len = 0;
+        ret = jpeg_enc_process(g_encoder.handle, static_cast<const uint8_t*>(img->data), in_size,
+                               g_encoder.outbuf, g_encoder.outbuf_size, &out_len);
+        if (ret == JPEG_ERR_OK) {
+            jpeg_img->data = g_encoder.outbuf;
+            jpeg_img->data_len = out_len;
+            return ret;
         }
 
-        // Build full file path
-        char full_path[256];
-        // snprintf(full_path, sizeof(full_path), "%s/%s", path, entry->d_name);
-        strlcpy(full_path, path, sizeof(full_path));
-        strlcat(full_path, "/", sizeof(full_path));
-        strlcat(full_path, entry->d_name, sizeof(full_path));
-        // Get file info
-        struct stat st;
-        if (stat(full_path, &st) == 0) {
-            if (S_ISREG(st.st_mode)) {
-                count++;
-            }
-        }
-        else {
-            ESP_LOGW("FILE_COUNT", "Could not stat file: %s", full_path);
+        // A very detailed frame may not fit, retry with a larger buffer
+        int new_size = g_encoder.outbuf_size * 2;
+        if (new_size > JPEG_OUTBUF_MAX_SIZE || !alloc_outbuf(new_size)) {
+            return ret;
         }
+        ESP_LOGW(TAG, "JPEG output buffer grown to %d bytes", new_size);
+    }
+}
+
+// --------- Public API ----------------------------------
+
+bool init() {
+#if CONFIG_BEESENSE_SD_SDMMC
+    return mount_sdcard_sdmmc();
+#else
+    return mount_sdcard_spi();
+#endif
+}
+
+bool create_dir(const char *full_path) {
+    if (!g_mounted) {
+        ESP_LOGE(TAG, "create_dir: SD not mounted");
+        return false;
     }
+    return naming::make_dir(full_path);
+}
 
-    closedir(dir);
-    return count;
+bool next_file_path(const char *dir_full_path, char *filepath, size_t filepath_len) {
+    if (!g_mounted) {
+        ESP_LOGE(TAG, "next_file_path: SD not mounted");
+        return false;
+    }
+    return g_namer.next_file_path(dir_full_path, filepath, filepath_len);
+}
+
+void set_jpeg_quality(int quality) {
+    g_jpeg_quality = std::clamp(quality, 1, 100);
 }
 
 bool save_detected_jpeg(const dl::image::img_t &img,
@@ -247,11 +473,6 @@ bool save_detected_jpeg(const dl::image::img_t &img,
         return false;
     }
 
-    // Make sure directory exists
-    if (!create_dir(dir_full_path)) {
-        return false;
-    }
-
     // Encode to JPEG
     dl::image::jpeg_img_t jpeg_img;
     jpeg_enc_config_t enc_cfg = {
@@ -259,36 +480,44 @@ bool save_detected_jpeg(const dl::image::img_t &img,
         .height = img.height,
         .src_type = JPEG_PIXEL_FORMAT_RGB888,
         .subsampling = JPEG_SUBSAMPLE_444,
-        .quality = 80,
+        .quality = g_jpeg_quality,
         .rotate = JPEG_ROTATE_0D,
         .task_enable = true,
         .hfm_task_priority = 13,
-        .hfm_task_core = 1,
+        .hfm_task_core = CONFIG_BEESENSE_STORAGE_CORE, // keep the Huffman task away from inference
     };
 
-    jpeg_error_t enc_ret = encode_img_to_jpeg(&img, &jpeg_img, enc_cfg);
+    jpeg_error_t enc_ret;
+    {
+        profiler::Scope scope(profiler::STAGE_JPEG_ENCODE);
+        enc_ret = encode_img_to_jpeg(&img, &jpeg_img, enc_cfg);
+    }
     if (enc_ret != JPEG_ERR_OK) {
         ESP_LOGE(TAG, "JPEG encoding failed (%d)", enc_ret);
         return false;
     }
 
-    // Determine next index in directory
-    int idx = count_files(dir_full_path);
-    if (idx < 0) {
-        free(jpeg_img.data);
+    // Determine next file name (creates the shard directory if needed)
+    char filepath[256];
+    if (!next_file_path(dir_full_path, filepath, sizeof(filepath))) {
         return false;
     }
 
-
-    char filepath[256];
-    std::snprintf(filepath, sizeof(filepath), "%s/bumblebee_%04d.jpg", dir_full_path, idx + 1);
+    // Hand the file to the writer task if it runs, so a slow card does not stall the caller.
+    // The file time is then set by FATFS itself through get_fattime().
+    if (sdwriter::is_running()) {
+        return sdwriter::submit(filepath, static_cast<const uint8_t *>(jpeg_img.data), jpeg_img.data_len);
+    }
 
     ESP_LOGI(TAG, "Saving detected JPEG: %s", filepath);
 
-    esp_err_t write_err = dl::image::write_jpeg(jpeg_img, filepath);
+    esp_err_t write_err;
+    {
+        profiler::Scope scope(profiler::STAGE_SD_WRITE);
+        write_err = dl::image::write_jpeg(jpeg_img, filepath);
+    }
     if (write_err != ESP_OK) {
         ESP_LOGE(TAG, "Failed to save JPEG: %s", filepath);
-        free(jpeg_img.data);
         return false;
     }
 
@@ -313,7 +542,6 @@ bool save_detected_jpeg(const dl::image::img_t &img,
     }
 
     ESP_LOGI(TAG, "Saved successfully");
-    free(jpeg_img.data);
     return true;
 }
 
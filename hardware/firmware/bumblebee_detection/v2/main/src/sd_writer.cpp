@@ -0,0 +1,167 @@
+#include "sd_writer.hpp"
+#include "profiler.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/ringbuf.h"
+#include "sdkconfig.h"
+
+namespace sdwriter {
+
+static const char *TAG = "SDWRITER";
+
+static constexpr size_t RING_SIZE = CONFIG_BEESENSE_SD_WRITER_RING_KB * 1024;
+
+// Every ring item is a header followed by the file contents
+struct record_header_t {
+    char path[112];
+    uint32_t len;
+};
+
+static RingbufHandle_t g_ring = nullptr;
+static stats_t g_stats = {};
+
+// --------- Internal helpers ----------------------------------
+
+static bool write_file(const char *path, const uint8_t *data, size_t len) {
+    profiler::Scope scope(profiler::STAGE_SD_WRITE);
+    FILE *f = fopen(path, "wb");
+    if (!f) {
+        ESP_LOGE(TAG, "Failed to open %s", path);
+        return false;
+    }
+    // One write call for the whole file so FATFS can write full clusters in sequence
+    size_t written = fwrite(data, 1, len, f);
+    fclose(f);
+    if (written != len) {
+        ESP_LOGE(TAG, "Short write on %s (%u of %u bytes)", path, (unsigned)written, (unsigned)len);
+        return false;
+    }
+    return true;
+}
+
+static void writer_task(void *arg) {
+    while (true) {
+        size_t item_size = 0;
+        uint8_t *item = static_cast<uint8_t *>(xRingbufferReceive(g_ring, &item_size, portMAX_DELAY));
+        if (!item) {
+            continue;
+        }
+
+        const record_header_t *header = reinterpret_cast<const record_header_t *>(item);
+        if (write_file(header->path, item + sizeof(record_header_t), header->len)) {
+            g_stats.written++;
+            ESP_LOGI(TAG, "Saved %s", header->path);
+        } else {
+            g_stats.write_errors++;
+        }
+        vRingbufferReturnItem(g_ring, item);
+    }
+}
+
+// Make room according to the configured policy. Returns false if item_size cannot be acquired.
+static bool acquire(size_t item_size, void **item) {
+#if CONFIG_BEESENSE_SD_WRITER_BLOCK
+    const TickType_t wait = pdMS_TO_TICKS(CONFIG_BEESENSE_SD_WRITER_BLOCK_TIMEOUT_MS);
+#else
+    const TickType_t wait = 0;
+#endif
+    if (xRingbufferSendAcquire(g_ring, item, item_size, wait) == pdTRUE) {
+        return true;
+    }
+
+#if CONFIG_BEESENSE_SD_WRITER_DROP_OLDEST
+    // Discard queued files, oldest first, until the new one fits
+    while (true) {
+        size_t old_size = 0;
+        void *old = xRingbufferReceive(g_ring, &old_size, 0);
+        if (!old) {
+            return false;
+        }
+        const record_header_t *header = static_cast<const record_header_t *>(old);
+        ESP_LOGW(TAG, "Ring full, dropping queued %s", header->path);
+        vRingbufferReturnItem(g_ring, old);
+        g_stats.dropped++;
+        if (xRingbufferSendAcquire(g_ring, item, item_size, 0) == pdTRUE) {
+            return true;
+        }
+    }
+#else
+    return false;
+#endif
+}
+
+// --------- Public API ----------------------------------
+
+bool start() {
+    if (g_ring) {
+        return true;
+    }
+
+    g_ring = xRingbufferCreateWithCaps(RING_SIZE, RINGBUF_TYPE_NOSPLIT, MALLOC_CAP_SPIRAM);
+    if (!g_ring) {
+        ESP_LOGE(TAG, "Failed to allocate %u byte ring", (unsigned)RING_SIZE);
+        return false;
+    }
+    g_stats.ring_size = RING_SIZE;
+    g_stats.min_free = xRingbufferGetCurFreeSize(g_ring);
+
+    if (xTaskCreatePinnedToCore(writer_task, "sd_writer", 4 * 1024, nullptr, CONFIG_BEESENSE_SD_WRITER_PRIORITY,
+                                nullptr, CONFIG_BEESENSE_STORAGE_CORE) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create writer task");
+        vRingbufferDeleteWithCaps(g_ring);
+        g_ring = nullptr;
+        return false;
+    }
+
+    ESP_LOGI(TAG, "SD writer started with %u KB ring", (unsigned)(RING_SIZE / 1024));
+    return true;
+}
+
+bool is_running() {
+    return g_ring != nullptr;
+}
+
+bool submit(const char *path, const uint8_t *data, size_t len) {
+    if (!g_ring) {
+        ESP_LOGE(TAG, "submit: writer not started");
+        return false;
+    }
+    if (strlen(path) >= sizeof(record_header_t::path)) {
+        ESP_LOGE(TAG, "submit: path too long: %s", path);
+        g_stats.dropped++;
+        return false;
+    }
+
+    const size_t item_size = sizeof(record_header_t) + len;
+    void *item = nullptr;
+    if (item_size > xRingbufferGetMaxItemSize(g_ring) || !acquire(item_size, &item)) {
+        ESP_LOGW(TAG, "Ring full, dropping %s", path);
+        g_stats.dropped++;
+        return false;
+    }
+
+    record_header_t *header = static_cast<record_header_t *>(item);
+    strlcpy(header->path, path, sizeof(header->path));
+    header->len = len;
+    memcpy(static_cast<uint8_t *>(item) + sizeof(record_header_t), data, len);
+    xRingbufferSendComplete(g_ring, item);
+    g_stats.queued++;
+
+    size_t free_size = xRingbufferGetCurFreeSize(g_ring);
+    if (free_size < g_stats.min_free) {
+        g_stats.min_free = free_size;
+    }
+    return true;
+}
+
+stats_t get_stats() {
+    return g_stats;
+}
+
+} // namespace sdwriter
@@ -0,0 +1,273 @@
+#include "settings.hpp"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sdkconfig.h"
+#include "esp_log.h"
+
+namespace settings {
+
+static const char *TAG = "SETTINGS";
+
+static constexpr int MAX_LINE_LEN = 128;
+
+enum type_t { T_INT, T_UINT, T_FLOAT, T_PATH };
+
+// One key of the file: where it lives in settings_t and which values are valid
+struct key_info_t {
+    const char *name;
+    type_t type;
+    size_t offset;
+    float min, max; // T_PATH: unused
+};
+
+#define KEY(field, type, min, max) {#field, type, offsetof(settings_t, field), min, max}
+
+static const key_info_t KEYS[] = {
+    KEY(score_thr, T_FLOAT, 0.0f, 1.0f),
+    KEY(class_mask, T_UINT, 1, 65535),
+    KEY(model_nms_thr, T_FLOAT, 0.0f, 1.0f),
+    KEY(escalate_score, T_FLOAT, 0.0f, 1.0f),
+    KEY(count_line_y, T_INT, 0, 1200),
+    KEY(zones_path, T_PATH, 0, 0),
+    KEY(active_interval_ms, T_UINT, 0, 600000),
+    KEY(quiet_after_s, T_UINT, 1, 86400),
+    KEY(quiet_interval_ms, T_UINT, 0, 600000),
+    KEY(night_start_hour, T_INT, 0, 23),
+    KEY(night_end_hour, T_INT, 0, 23),
+    KEY(night_interval_ms, T_UINT, 0, 3600000),
+    KEY(power_down_min_ms, T_UINT, 0, 3600000),
+    KEY(jpeg_quality, T_INT, 1, 100),
+    KEY(save_min_score, T_FLOAT, 0.0f, 1.0f),
+    KEY(image_dir, T_PATH, 0, 0),
+    KEY(event_log_path, T_PATH, 0, 0),
+};
+
+#undef KEY
+
+static constexpr int NUM_KEYS = sizeof(KEYS) / sizeof(KEYS[0]);
+
+// --------- Internal helpers ----------------------------------
+
+static char *trim(char *s) {
+    while (*s == ' ' || *s == '\t') {
+        ++s;
+    }
+    char *end = s + strlen(s);
+    while (end > s && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r' || end[-1] == '\n')) {
+        --end;
+    }
+    *end = '\0';
+    return s;
+}
+
+static const key_info_t *find_key(const char *name) {
+    for (int i = 0; i < NUM_KEYS; ++i) {
+        if (strcmp(KEYS[i].name, name) == 0) {
+            return &KEYS[i];
+        }
+    }
+    return nullptr;
+}
+
+// Convert and range-check value, then store it; s stays untouched on errors
+static bool set_value(const key_info_t &key, const char *value, settings_t &s) {
+    uint8_t *field = reinterpret_cast<uint8_t *>(&s) + key.offset;
+    if (key.type == T_PATH) {
+        const size_t len = strlen(value);
+        if (len == 0 || len >= PATH_LEN || value[0] != '/') {
+            return false;
+        }
+        memcpy(field, value, len + 1);
+        return true;
+    }
+
+    char *end;
+    const float v = key.type == T_FLOAT ? strtof(value, &end) : float(strtol(value, &end, 10));
+    if (end == value || *end != '\0' || v < key.min || v > key.max) {
+        return false;
+    }
+    if (key.type == T_FLOAT) {
+        *reinterpret_cast<float *>(field) = v;
+    } else if (key.type == T_INT) {
+        *reinterpret_cast<int *>(field) = int(strtol(value, nullptr, 10));
+    } else {
+        *reinterpret_cast<uint32_t *>(field) = uint32_t(strtol(value, nullptr, 10));
+    }
+    return true;
+}
+
+// true for empty, comment and valid lines
+static bool parse_line(char *line, int line_no, settings_t &s) {
+    char *comment = strchr(line, '#');
+    if (comment) {
+        *comment = '\0';
+    }
+    char *text = trim(line);
+    if (*text == '\0') {
+        return true;
+    }
+    char *eq = strchr(text, '=');
+    if (!eq) {
+        ESP_LOGE(TAG, "Line %d: expected key = value", line_no);
+        return false;
+    }
+    *eq = '\0';
+    const char *name = trim(text);
+    const char *value = trim(eq + 1);
+
+    const key_info_t *key = find_key(name);
+    if (!key) {
+        ESP_LOGE(TAG, "Line %d: unknown key '%s'", line_no, name);
+        return false;
+    }
+    if (!set_value(*key, value, s)) {
+        if (key->type == T_PATH) {
+            ESP_LOGE(TAG, "Line %d: %s must be an absolute path below %d characters", line_no, name, PATH_LEN);
+        } else {
+            ESP_LOGE(TAG, "Line %d: %s = '%s' is not a number in [%g, %g]", line_no, name, value,
+                     double(key->min), double(key->max));
+        }
+        return false;
+    }
+    return true;
+}
+
+static void format_value(const key_info_t &key, const settings_t &s, char *buf, size_t len) {
+    const uint8_t *field = reinterpret_cast<const uint8_t *>(&s) + key.offset;
+    switch (key.type) {
+    case T_INT:
+        snprintf(buf, len, "%d", *reinterpret_cast<const int *>(field));
+        break;
+    case T_UINT:
+        snprintf(buf, len, "%u", (unsigned)*reinterpret_cast<const uint32_t *>(field));
+        break;
+    case T_FLOAT:
+        snprintf(buf, len, "%.3f", double(*reinterpret_cast<const float *>(field)));
+        break;
+    case T_PATH:
+        snprintf(buf, len, "%s", reinterpret_cast<const char *>(field));
+        break;
+    }
+}
+
+// --------- Public API ----------------------------------
+
+settings_t defaults() {
+    settings_t s = {};
+    s.score_thr = 0.35f;
+    s.class_mask = 1 << 0;    // bumblebee
+    s.model_nms_thr = 0.7f;   // ESPDet::default_nms_thr
+#ifdef CONFIG_BEESENSE_ADAPTIVE_ESCALATE_SCORE_PERCENT
+    s.escalate_score = CONFIG_BEESENSE_ADAPTIVE_ESCALATE_SCORE_PERCENT / 100.0f;
+#else
+    s.escalate_score = 0.25f;
+#endif
+
+    s.count_line_y = CONFIG_BEESENSE_COUNT_LINE_Y;
+#ifdef CONFIG_BEESENSE_ZONES_PATH
+    strncpy(s.zones_path, CONFIG_BEESENSE_ZONES_PATH, PATH_LEN - 1);
+#else
+    strncpy(s.zones_path, "/sdcard/zones.txt", PATH_LEN - 1);
+#endif
+
+#if CONFIG_BEESENSE_SCHEDULER
+    s.active_interval_ms = CONFIG_BEESENSE_SCHEDULER_ACTIVE_INTERVAL_MS;
+    s.quiet_after_s = CONFIG_BEESENSE_SCHEDULER_QUIET_AFTER_S;
+    s.quiet_interval_ms = CONFIG_BEESENSE_SCHEDULER_QUIET_INTERVAL_MS;
+    s.night_start_hour = CONFIG_BEESENSE_SCHEDULER_NIGHT_START;
+    s.night_end_hour = CONFIG_BEESENSE_SCHEDULER_NIGHT_END;
+    s.night_interval_ms = CONFIG_BEESENSE_SCHEDULER_NIGHT_INTERVAL_MS;
+    s.power_down_min_ms = CONFIG_BEESENSE_SCHEDULER_POWER_DOWN_MIN_MS;
+#else
+    // Without the scheduler the pipeline runs free, the keys are accepted but unused
+    s.quiet_after_s = 30;
+    s.quiet_interval_ms = 1000;
+    s.night_interval_ms = 10000;
+    s.power_down_min_ms = 2000;
+#endif
+
+    s.jpeg_quality = 80;
+#if CONFIG_BEESENSE_SAVE_DETECTIONS
+    s.save_min_score = CONFIG_BEESENSE_SAVE_MIN_SCORE_PERCENT / 100.0f;
+#else
+    s.save_min_score = 1.0f;
+#endif
+    strncpy(s.image_dir, "/sdcard/bumblebee_tracking", PATH_LEN - 1);
+#ifdef CONFIG_BEESENSE_EVENT_LOG_PATH
+    strncpy(s.event_log_path, CONFIG_BEESENSE_EVENT_LOG_PATH, PATH_LEN - 1);
+#else
+    strncpy(s.event_log_path, "/sdcard/events.bin", PATH_LEN - 1);
+#endif
+    return s;
+}
+
+int parse(const char *text, settings_t &s) {
+    char line[MAX_LINE_LEN];
+    int rejected = 0;
+    for (int line_no = 1; *text; ++line_no) {
+        const size_t len = strcspn(text, "\n");
+        const bool fits = len < sizeof(line);
+        if (fits) {
+            memcpy(line, text, len);
+            line[len] = '\0';
+        }
+        text += len + (text[len] == '\n');
+        if (!fits) {
+            ESP_LOGE(TAG, "Line %d: too long", line_no);
+            rejected++;
+        } else if (!parse_line(line, line_no, s)) {
+            rejected++;
+        }
+    }
+    return rejected;
+}
+
+int load(const char *path, settings_t &s) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+    char line[MAX_LINE_LEN];
+    int rejected = 0;
+    bool skipping = false; // rest of a line that did not fit into the buffer
+    for (int line_no = 1; fgets(line, sizeof(line), f);) {
+        const bool complete = strchr(line, '\n') || feof(f);
+        if (skipping) {
+            skipping = !complete;
+            line_no += complete;
+            continue;
+        }
+        if (!complete) {
+            ESP_LOGE(TAG, "Line %d: too long", line_no);
+            rejected++;
+            skipping = true;
+            continue;
+        }
+        rejected += !parse_line(line, line_no, s);
+        line_no++;
+    }
+    fclose(f);
+    ESP_LOGI(TAG, "%s read, %d lines rejected", path, rejected);
+    return rejected;
+}
+
+void dump(const settings_t &s) {
+    const settings_t def = defaults();
+    char value[PATH_LEN + 8];
+    char def_value[PATH_LEN + 8];
+    for (int i = 0; i < NUM_KEYS; ++i) {
+        format_value(KEYS[i], s, value, sizeof(value));
+        format_value(KEYS[i], def, def_value, sizeof(def_value));
+        if (strcmp(value, def_value) != 0) {
+            ESP_LOGI(TAG, "%-20s %s (default %s)", KEYS[i].name, value, def_value);
+        } else {
+            ESP_LOGI(TAG, "%-20s %s", KEYS[i].name, value);
+        }
+    }
+}
+
+} // namespace settings
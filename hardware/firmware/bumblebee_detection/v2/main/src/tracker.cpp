@@ -0,0 +1,156 @@
+#include "tracker.hpp"
+
+#include <algorithm>
+
+namespace tracker {
+
+// --------- Internal helpers ----------------------------------
+
+static float iou(const box_t &a, const box_t &b) {
+    const int ix1 = std::max(a.x1, b.x1);
+    const int iy1 = std::max(a.y1, b.y1);
+    const int ix2 = std::min(a.x2, b.x2);
+    const int iy2 = std::min(a.y2, b.y2);
+    if (ix2 <= ix1 || iy2 <= iy1) {
+        return 0.0f;
+    }
+    const float inter = float(ix2 - ix1) * float(iy2 - iy1);
+    const float area_a = float(a.x2 - a.x1) * float(a.y2 - a.y1);
+    const float area_b = float(b.x2 - b.x1) * float(b.y2 - b.y1);
+    return inter / (area_a + area_b - inter);
+}
+
+// --------- Tracker ----------------------------------
+
+Tracker::Tracker(const config_t &cfg) :
+    m_cfg(cfg), m_num_tracks(0), m_next_id(1), m_stats{}
+{
+}
+
+void Tracker::reset()
+{
+    m_num_tracks = 0;
+}
+
+bool Tracker::match_cost(const track_t &track, const box_t &det, float &cost) const
+{
+    // Constant-velocity prediction from the last two matched centers
+    const int px = track.cx + (track.cx - track.prev_cx);
+    const int py = track.cy + (track.cy - track.prev_cy);
+    const int dx = (det.x1 + det.x2) / 2 - px;
+    const int dy = (det.y1 + det.y2) / 2 - py;
+    const int dist2 = dx * dx + dy * dy;
+    const float overlap = iou(track.box, det);
+
+    const bool near = dist2 <= m_cfg.max_distance * m_cfg.max_distance;
+    if (overlap < m_cfg.min_iou && !near) {
+        return false;
+    }
+    // Overlap dominates, the squared distance breaks ties between boxes without overlap
+    const float max_dist2 = float(std::max(1, m_cfg.max_distance * m_cfg.max_distance));
+    cost = (1.0f - overlap) + float(dist2) / max_dist2;
+    return true;
+}
+
+void Tracker::add_track(const box_t &det, uint32_t *track_id)
+{
+    if (m_num_tracks == MAX_TRACKS) {
+        *track_id = 0;
+        return;
+    }
+    track_t &track = m_tracks[m_num_tracks++];
+    track.id = m_next_id++;
+    track.box = det;
+    track.cx = track.prev_cx = (det.x1 + det.x2) / 2;
+    track.cy = track.prev_cy = (det.y1 + det.y2) / 2;
+    track.hits = 1;
+    track.age = 0;
+    track.confirmed = m_cfg.min_hits <= 1;
+    m_stats.created++;
+    if (track.confirmed) {
+        m_stats.confirmed++;
+    }
+    *track_id = track.id;
+}
+
+void Tracker::update(const box_t *detections, int num_detections, uint32_t *track_ids)
+{
+    m_stats.frames++;
+    num_detections = std::min(num_detections, MAX_DETECTIONS);
+
+    uint32_t ids[MAX_DETECTIONS] = {};
+    bool track_matched[MAX_TRACKS] = {};
+    bool det_matched[MAX_DETECTIONS] = {};
+
+    // All admissible track/detection pairs, cheapest first
+    int num_candidates = 0;
+    for (int t = 0; t < m_num_tracks; ++t) {
+        for (int d = 0; d < num_detections; ++d) {
+            float cost;
+            if (match_cost(m_tracks[t], detections[d], cost)) {
+                m_candidates[num_candidates++] = {cost, int8_t(t), int8_t(d)};
+            }
+        }
+    }
+    std::sort(m_candidates, m_candidates + num_candidates,
+              [](const candidate_t &a, const candidate_t &b) { return a.cost < b.cost; });
+
+    // Greedy assignment: take the cheapest pair whose track and detection are both still free
+    for (int i = 0; i < num_candidates; ++i) {
+        const candidate_t &c = m_candidates[i];
+        if (track_matched[c.track] || det_matched[c.detection]) {
+            continue;
+        }
+        track_matched[c.track] = true;
+        det_matched[c.detection] = true;
+
+        track_t &track = m_tracks[c.track];
+        const box_t &det = detections[c.detection];
+        track.prev_cx = track.cx;
+        track.prev_cy = track.cy;
+        track.box = det;
+        track.cx = (det.x1 + det.x2) / 2;
+        track.cy = (det.y1 + det.y2) / 2;
+        track.hits++;
+        track.age = 0;
+        if (!track.confirmed && track.hits >= m_cfg.min_hits) {
+            track.confirmed = true;
+            m_stats.confirmed++;
+        }
+        ids[c.detection] = track.id;
+    }
+
+    // Age unmatched tracks and drop expired ones, keeping the array compact.
+    // New tracks are appended afterwards, so track_matched still lines up here.
+    int kept = 0;
+    for (int t = 0; t < m_num_tracks; ++t) {
+        track_t &track = m_tracks[t];
+        if (!track_matched[t]) {
+            track.age++;
+            // Without a new center the track must not look like it moved again
+            track.prev_cx = track.cx;
+            track.prev_cy = track.cy;
+            if (track.age > m_cfg.max_age) {
+                m_stats.expired++;
+                continue;
+            }
+        }
+        if (kept != t) {
+            m_tracks[kept] = track;
+        }
+        kept++;
+    }
+    m_num_tracks = kept;
+
+    for (int d = 0; d < num_detections; ++d) {
+        if (!det_matched[d]) {
+            add_track(detections[d], &ids[d]);
+        }
+    }
+
+    if (track_ids) {
+        std::copy(ids, ids + num_detections, track_ids);
+    }
+}
+
+} // namespace tracker
@@ -0,0 +1,327 @@
+#include "zone_counter.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+
+namespace counting {
+
+static const char *TAG = "COUNTING";
+
+// Endpoints of horizontal_line(), products of coordinates stay far inside int64
+static constexpr int LINE_EXTENT = 1 << 15;
+static constexpr int MAX_LINE_LEN = 256;
+
+// --------- Geometry ----------------------------------
+
+// > 0 if p is left of a->b, < 0 if right, 0 on the line (y grows downwards)
+static inline int64_t side(const point_t &a, const point_t &b, const point_t &p) {
+    return int64_t(b.x - a.x) * (p.y - a.y) - int64_t(b.y - a.y) * (p.x - a.x);
+}
+
+// Even-odd rule; points on an edge may fall either way, but always the same way
+static bool inside(const zone_t &zone, const point_t &p) {
+    bool in = false;
+    for (int i = 0, j = zone.num_points - 1; i < zone.num_points; j = i++) {
+        const point_t &a = zone.points[i];
+        const point_t &b = zone.points[j];
+        if ((a.y > p.y) != (b.y > p.y)) {
+            // x of the edge at p.y, compared without division
+            const int64_t lhs = int64_t(p.x - a.x) * (b.y - a.y);
+            const int64_t rhs = int64_t(b.x - a.x) * (p.y - a.y);
+            if ((b.y > a.y) ? lhs < rhs : lhs > rhs) {
+                in = !in;
+            }
+        }
+    }
+    return in;
+}
+
+static inline int sign(int64_t v) {
+    return (v > 0) - (v < 0);
+}
+
+// Did the center move across the line, and in which direction?
+// Like the former y_line test, a move counts once it leaves one side strictly and
+// reaches the line or the other side, in the direction it came from. A center on the
+// line has already been counted and counts nothing when it moves on, so touching
+// the line and turning back counts once.
+static bool crosses_line(const zone_t &zone, const point_t &prev, const point_t &cur, direction_t &direction) {
+    const point_t &a = zone.points[0];
+    const point_t &b = zone.points[1];
+    const int prev_side = sign(side(a, b, prev));
+    if (prev_side == 0 || sign(side(a, b, cur)) == prev_side) {
+        return false;
+    }
+    // The move has to pass between the endpoints, not beside the segment
+    const int64_t sa = side(prev, cur, a);
+    const int64_t sb = side(prev, cur, b);
+    if ((sa > 0 && sb > 0) || (sa < 0 && sb < 0)) {
+        return false;
+    }
+    // Coming from the side an Einflug leads to is an Ausflug
+    const point_t towards = {a.x + zone.dx, a.y + zone.dy};
+    direction = prev_side == sign(side(a, b, towards)) ? AUSFLUG : EINFLUG;
+    return true;
+}
+
+static bool crosses_polygon(const zone_t &zone, const point_t &prev, const point_t &cur, direction_t &direction) {
+    const bool was_in = inside(zone, prev);
+    const bool is_in = inside(zone, cur);
+    if (was_in == is_in) {
+        return false;
+    }
+    direction = (is_in == zone.enter_is_einflug) ? EINFLUG : AUSFLUG;
+    return true;
+}
+
+// --------- Zone file ----------------------------------
+
+static bool parse_int(char **save, int &value) {
+    const char *tok = strtok_r(nullptr, " \t", save);
+    if (!tok) {
+        return false;
+    }
+    char *end;
+    value = int(strtol(tok, &end, 10));
+    return *end == '\0';
+}
+
+// Parse one line of a zone file into zones[num], returns 1 for a zone, 0 for an
+// empty or comment line, -1 on errors
+static int parse_line(char *line, int line_no, zone_t *zones, int num, int max_zones) {
+    char *comment = strchr(line, '#');
+    if (comment) {
+        *comment = '\0';
+    }
+    line[strcspn(line, "\r\n")] = '\0';
+
+    char *save = nullptr;
+    const char *keyword = strtok_r(line, " \t", &save);
+    if (!keyword) {
+        return 0;
+    }
+    if (strcmp(keyword, "line") != 0 && strcmp(keyword, "poly") != 0) {
+        ESP_LOGE(TAG, "Line %d: unknown zone type '%s'", line_no, keyword);
+        return -1;
+    }
+    if (num >= max_zones) {
+        ESP_LOGE(TAG, "Line %d: more than %d zones", line_no, max_zones);
+        return -1;
+    }
+    const char *name = strtok_r(nullptr, " \t", &save);
+    if (!name) {
+        ESP_LOGE(TAG, "Line %d: zone without a name", line_no);
+        return -1;
+    }
+
+    zone_t zone = {};
+    strncpy(zone.name, name, ZONE_NAME_LEN - 1);
+    if (strcmp(keyword, "line") == 0) {
+        zone.type = ZONE_LINE;
+        zone.num_points = 2;
+        if (!parse_int(&save, zone.points[0].x) || !parse_int(&save, zone.points[0].y) ||
+            !parse_int(&save, zone.points[1].x) || !parse_int(&save, zone.points[1].y) ||
+            !parse_int(&save, zone.dx) || !parse_int(&save, zone.dy)) {
+            ESP_LOGE(TAG, "Line %d: expected line <name> x0 y0 x1 y1 dx dy", line_no);
+            return -1;
+        }
+    } else {
+        zone.type = ZONE_POLYGON;
+        const char *mode = strtok_r(nullptr, " \t", &save);
+        if (!mode || (strcmp(mode, "in") != 0 && strcmp(mode, "out") != 0)) {
+            ESP_LOGE(TAG, "Line %d: expected poly <name> in|out x0 y0 x1 y1 ...", line_no);
+            return -1;
+        }
+        zone.enter_is_einflug = strcmp(mode, "in") == 0;
+        const char *tok;
+        while ((tok = strtok_r(nullptr, " \t", &save))) {
+            point_t p;
+            char *end;
+            p.x = int(strtol(tok, &end, 10));
+            if (*end != '\0' || zone.num_points == MAX_ZONE_POINTS || !parse_int(&save, p.y)) {
+                ESP_LOGE(TAG, "Line %d: expected up to %d x y pairs", line_no, MAX_ZONE_POINTS);
+                return -1;
+            }
+            zone.points[zone.num_points++] = p;
+        }
+    }
+    if (zone.type == ZONE_LINE && strtok_r(nullptr, " \t", &save)) {
+        ESP_LOGE(TAG, "Line %d: trailing characters", line_no);
+        return -1;
+    }
+    if (!validate(zone)) {
+        ESP_LOGE(TAG, "Line %d: invalid zone", line_no);
+        return -1;
+    }
+    zones[num] = zone;
+    return 1;
+}
+
+// --------- Public API ----------------------------------
+
+zone_t horizontal_line(int y) {
+    zone_t zone = {};
+    strncpy(zone.name, "line", ZONE_NAME_LEN - 1);
+    zone.type = ZONE_LINE;
+    zone.points[0] = {-LINE_EXTENT, y};
+    zone.points[1] = {LINE_EXTENT, y};
+    zone.num_points = 2;
+    zone.dx = 0;
+    zone.dy = -1;
+    return zone;
+}
+
+bool validate(const zone_t &zone) {
+    if (zone.type == ZONE_LINE) {
+        const point_t &a = zone.points[0];
+        const point_t &b = zone.points[1];
+        if (zone.num_points != 2 || (a.x == b.x && a.y == b.y)) {
+            ESP_LOGE(TAG, "Zone %s: a line needs two different points", zone.name);
+            return false;
+        }
+        if (side(a, b, {a.x + zone.dx, a.y + zone.dy}) == 0) {
+            ESP_LOGE(TAG, "Zone %s: direction (%d, %d) runs along the line", zone.name, zone.dx, zone.dy);
+            return false;
+        }
+        return true;
+    }
+    if (zone.type == ZONE_POLYGON && zone.num_points >= 3 && zone.num_points <= MAX_ZONE_POINTS) {
+        return true;
+    }
+    ESP_LOGE(TAG, "Zone %s: a polygon needs 3 to %d points", zone.name, MAX_ZONE_POINTS);
+    return false;
+}
+
+int parse_zones(const char *text, zone_t *zones, int max_zones) {
+    char line[MAX_LINE_LEN];
+    int num = 0;
+    for (int line_no = 1; *text; ++line_no) {
+        size_t len = strcspn(text, "\n");
+        if (len >= sizeof(line)) {
+            ESP_LOGE(TAG, "Line %d: too long", line_no);
+            return -1;
+        }
+        memcpy(line, text, len);
+        line[len] = '\0';
+        text += len + (text[len] == '\n');
+
+        const int ret = parse_line(line, line_no, zones, num, max_zones);
+        if (ret < 0) {
+            return -1;
+        }
+        num += ret;
+    }
+    return num;
+}
+
+int load_zones(const char *path, zone_t *zones, int max_zones) {
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        return -1;
+    }
+    char line[MAX_LINE_LEN];
+    int num = 0;
+    for (int line_no = 1; fgets(line, sizeof(line), f); ++line_no) {
+        if (!strchr(line, '\n') && !feof(f)) {
+            ESP_LOGE(TAG, "Line %d: too long", line_no);
+            num = -1;
+            break;
+        }
+        const int ret = parse_line(line, line_no, zones, num, max_zones);
+        if (ret < 0) {
+            num = -1;
+            break;
+        }
+        num += ret;
+    }
+    fclose(f);
+    if (num >= 0) {
+        ESP_LOGI(TAG, "%d zones loaded from %s", num, path);
+    }
+    return num;
+}
+
+// --------- ZoneCounter ----------------------------------
+
+ZoneCounter::ZoneCounter() : m_num_zones(0), m_einflug{}, m_ausflug{}, m_num_last(0)
+{
+}
+
+bool ZoneCounter::set_zones(const zone_t *zones, int num_zones)
+{
+    if (num_zones < 0 || num_zones > MAX_ZONES) {
+        ESP_LOGE(TAG, "%d zones, at most %d are supported", num_zones, MAX_ZONES);
+        return false;
+    }
+    for (int i = 0; i < num_zones; ++i) {
+        if (!validate(zones[i])) {
+            return false;
+        }
+    }
+    for (int i = 0; i < num_zones; ++i) {
+        m_zones[i] = zones[i];
+        m_einflug[i] = 0;
+        m_ausflug[i] = 0;
+    }
+    m_num_zones = num_zones;
+    m_num_last = 0;
+    return true;
+}
+
+int ZoneCounter::update(const tracker::Tracker &tracks)
+{
+    // Every confirmed track that was matched in this frame and moved across a zone counts once per zone
+    m_num_last = 0;
+    for (int i = 0; i < tracks.num_tracks(); ++i) {
+        const tracker::track_t &track = tracks.track(i);
+        if (!track.confirmed || track.age != 0) {
+            continue;
+        }
+        const point_t prev = {track.prev_cx, track.prev_cy};
+        const point_t cur = {track.cx, track.cy};
+        if (prev.x == cur.x && prev.y == cur.y) {
+            continue;
+        }
+        for (int z = 0; z < m_num_zones; ++z) {
+            const zone_t &zone = m_zones[z];
+            direction_t direction;
+            const bool crossed = zone.type == ZONE_LINE ? crosses_line(zone, prev, cur, direction)
+                                                        : crosses_polygon(zone, prev, cur, direction);
+            if (!crossed) {
+                continue;
+            }
+            if (direction == EINFLUG) {
+                m_einflug[z]++;
+                ESP_LOGI(TAG, "Einflug erkannt! (Track %u, Zone %s)", (unsigned)track.id, zone.name);
+            } else {
+                m_ausflug[z]++;
+                ESP_LOGI(TAG, "Ausflug erkannt! (Track %u, Zone %s)", (unsigned)track.id, zone.name);
+            }
+            m_last[m_num_last++] = {track.id, uint8_t(z), direction};
+        }
+    }
+    return m_num_last;
+}
+
+int ZoneCounter::einflug() const
+{
+    int sum = 0;
+    for (int z = 0; z < m_num_zones; ++z) {
+        sum += m_einflug[z];
+    }
+    return sum;
+}
+
+int ZoneCounter::ausflug() const
+{
+    int sum = 0;
+    for (int z = 0; z < m_num_zones; ++z) {
+        sum += m_ausflug[z];
+    }
+    return sum;
+}
+
+} // namespace counting
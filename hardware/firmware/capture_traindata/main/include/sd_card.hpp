@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stddef.h>
+
 #include "dl_image_define.hpp"
 #include "dl_cls_postprocessor.hpp"  // for dl::cls::result_t
 
@@ -9,7 +11,11 @@ bool init();
 
 bool create_dir(const char *full_path);
 
-int count_files(const char *full_path);
+// Full path for the next bumblebee_XXXXXX.jpg below dir_full_path. Files are sharded
+// into numbered subdirectories with at most CONFIG_BEESENSE_SD_FILES_PER_DIR files,
+// which are created on demand. The directory is scanned once, later calls are
+// answered from memory.
+bool next_file_path(const char *dir_full_path, char *filepath, size_t filepath_len);
 
 bool save_jpeg(const dl::image::img_t &img, const dl::cls::result_t &best, const char *dir_full_path);
 
@@ -8,17 +8,17 @@
 #include "driver/gpio.h"
 
 
-#include <sys/stat.h>
 #include <time.h>
-#include <dirent.h>
-#include <cstring>
 #include <cstdio>
+#include <cstdlib>
 #include "ff.h" // Für FATFS Zeitstempel
+#include "sdkconfig.h"
 
 #include "esp_jpeg_enc.h"
 #include "dl_image_jpeg.hpp"
 
 #include "include/sd_pins.h"  // the board-specific SD + SPI pins
+#include "file_naming.hpp"
 
 namespace sdcard {
 
@@ -28,6 +28,10 @@ static constexpr const char *MOUNT_POINT = "/sdcard";
 static sdmmc_card_t *g_card = nullptr;
 static bool g_mounted = false;
 
+// Next file name per output directory, same sharding and index recovery as the
+// detection firmware (<dir>/0000/bumblebee_000001.jpg, ...)
+static naming::FileNamer g_namer(CONFIG_BEESENSE_SD_FILES_PER_DIR);
+
 // --------- Internal helpers ----------------------------------
 
 static void init_sd_enable_pin(void) {
@@ -172,63 +176,15 @@ bool create_dir(const char *full_path) {
         ESP_LOGE(TAG, "create_dir: SD not mounted");
         return false;
     }
-
-    struct stat st;
-    if (stat(full_path, &st) == 0) {
-        if (S_ISDIR(st.st_mode)) {
-            ESP_LOGI(TAG, "Dir already exists: %s", full_path);
-            return true;
-        } else {
-            ESP_LOGE(TAG, "Path exists but is not a directory: %s", full_path);
-            return false;
-        }
-    }
-
-    int res = mkdir(full_path, 0775);
-    if (res == 0) {
-        ESP_LOGI(TAG, "Created dir: %s", full_path);
-        return true;
-    } else {
-        ESP_LOGE(TAG, "mkdir failed for %s (errno=%d)", full_path, errno);
-        return false;
-    }
+    return naming::make_dir(full_path);
 }
 
-int count_files(const char *path) {
-    int count = 0;
-    DIR *dir = opendir(path);
-    if (!dir) {
-        ESP_LOGE("FILE_COUNT", "Failed to open directory: %s", path);
-        return -1;
-    }
-
-    struct dirent *entry;
-    while ((entry = readdir(dir)) != nullptr) {
-        // Skip current and parent directory entries
-        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) {
-            continue;
-        }
-
-        // Build full file path
-        char full_path[256];
-        // snprintf(full_path, sizeof(full_path), "%s/%s", path, entry->d_name);
-        strlcpy(full_path, path, sizeof(full_path));
-        strlcat(full_path, "/", sizeof(full_path));
-        strlcat(full_path, entry->d_name, sizeof(full_path));
-        // Get file info
-        struct stat st;
-        if (stat(full_path, &st) == 0) {
-            if (S_ISREG(st.st_mode)) {
-                count++;
-            }
-        }
-        else {
-            ESP_LOGW("FILE_COUNT", "Could not stat file: %s", full_path);
-        }
+bool next_file_path(const char *dir_full_path, char *filepath, size_t filepath_len) {
+    if (!g_mounted) {
+        ESP_LOGE(TAG, "next_file_path: SD not mounted");
+        return false;
     }
-
-    closedir(dir);
-    return count;
+    return g_namer.next_file_path(dir_full_path, filepath, filepath_len);
 }
 
 bool save_jpeg(const dl::image::img_t &img,
@@ -247,11 +203,6 @@ bool save_jpeg(const dl::image::img_t &img,
         return false;
     }
 
-    // Make sure directory exists
-    if (!create_dir(dir_full_path)) {
-        return false;
-    }
-
     // Encode to JPEG
     dl::image::jpeg_img_t jpeg_img;
     jpeg_enc_config_t enc_cfg = {
@@ -272,17 +223,13 @@ bool save_jpeg(const dl::image::img_t &img,
         return false;
     }
 
-    // Determine next index in directory
-    int idx = count_files(dir_full_path);
-    if (idx < 0) {
+    // Determine next file name (creates the shard directory if needed)
+    char filepath[256];
+    if (!next_file_path(dir_full_path, filepath, sizeof(filepath))) {
         free(jpeg_img.data);
         return false;
     }
 
-
-    char filepath[256];
-    std::snprintf(filepath, sizeof(filepath), "%s/bumblebee_%04d.jpg", dir_full_path, idx + 1);
-
     ESP_LOGI(TAG, "Saving detected JPEG: %s", filepath);
 
     esp_err_t write_err = dl::image::write_jpeg(jpeg_img, filepath);